@@ -0,0 +1,139 @@
+// =============================================================================
+//  LockBench.cpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		LockBench.cpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Benchmark of the tbc spin locks against tbc::Mutex
+
+	Every thread takes the lock, increments a shared counter and releases
+	it, as fast as it can. The table shows the wall time divided by the
+	total number of acquires, so lower is better and a lock that scales
+	perfectly stays flat as the thread number grows. Build with
+
+		g++ -std=c++11 -O2 -D_PTHREAD -pthread -Iinclude bench/LockBench.cpp -o LockBench
+
+	and run as LockBench [acquires per thread] [max threads].
+*/
+
+// Includes --------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include "tbc/Mutex.hpp"
+#include "tbc/Thread.hpp"
+#include "tbc/SpinLock.hpp"
+#include "tbc/TicketLock.hpp"
+#include "tbc/MCSLock.hpp"
+#include "tbc/FunctionThread.hpp"
+#include "tbc/Latch.hpp"
+#include "tbc/Stopwatch.hpp"
+
+
+// Constatns -------------------------------------------------------------------
+const static unsigned int	DEFAULT_ACQUIRE_NUM					= 100000;
+const static unsigned int	DEFAULT_MAX_THREAD_NUM				= 64;
+
+
+// -----------------------------------------------------------------------------
+// runBench
+// -----------------------------------------------------------------------------
+//	Returns nanoseconds per acquire, or a negative value if the counter
+//	shows that the lock let two threads in at once
+template <class L>
+static double	runBench(unsigned int inThreadNum, unsigned int inAcquireNum)
+{
+	L					lock;
+	uint64_t			counter = 0;
+	tbc::Latch			readyLatch(inThreadNum);
+	tbc::Latch			startLatch(1);
+	std::vector<tbc::FunctionThread>	threads(inThreadNum);
+
+	for (unsigned int i = 0; i < inThreadNum; i++)
+	{
+		threads[i].setRunner([&]()
+		{
+			readyLatch.countDown();
+			startLatch.wait();
+			for (unsigned int n = 0; n < inAcquireNum; n++)
+			{
+				lock.lock();
+				counter++;
+				lock.unlock();
+			}
+		});
+		threads[i].start();
+	}
+
+	readyLatch.wait();
+	tbc::Stopwatch	stopwatch;
+	startLatch.countDown();
+	for (unsigned int i = 0; i < inThreadNum; i++)
+		threads[i].join();
+	uint64_t	elapsed = stopwatch.getElapsed();
+
+	uint64_t	total = (uint64_t )inThreadNum * inAcquireNum;
+	if (counter != total)
+		return -1.0;
+	return (double )elapsed / (double )total;
+}
+
+// -----------------------------------------------------------------------------
+// main
+// -----------------------------------------------------------------------------
+int	main(int argc, char *argv[])
+{
+	unsigned int	acquireNum = DEFAULT_ACQUIRE_NUM;
+	unsigned int	maxThreadNum = DEFAULT_MAX_THREAD_NUM;
+
+	if (argc > 1)
+		acquireNum = (unsigned int )strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		maxThreadNum = (unsigned int )strtoul(argv[2], NULL, 10);
+	if (acquireNum == 0 || maxThreadNum == 0)
+	{
+		fprintf(stderr, "usage: %s [acquires per thread] [max threads]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%u acquires per thread, ns per acquire\n", acquireNum);
+	printf("%8s %12s %12s %12s %12s\n", "threads", "SpinLock", "TicketLock", "MCSLock", "Mutex");
+
+	bool	isFailed = false;
+	for (unsigned int threadNum = 1; threadNum <= maxThreadNum; threadNum *= 2)
+	{
+		double	results[4];
+		results[0] = runBench<tbc::SpinLock>(threadNum, acquireNum);
+		results[1] = runBench<tbc::TicketLock>(threadNum, acquireNum);
+		results[2] = runBench<tbc::MCSLock>(threadNum, acquireNum);
+		results[3] = runBench<tbc::Mutex>(threadNum, acquireNum);
+
+		printf("%8u", threadNum);
+		for (int i = 0; i < 4; i++)
+		{
+			if (results[i] < 0)
+			{
+				printf(" %12s", "BROKEN");
+				isFailed = true;
+			}
+			else
+				printf(" %12.1f", results[i]);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	return (isFailed != false) ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+// =============================================================================
+//  Barrier.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Barrier.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc reusable barrier
+
+	This file defines a barrier for a fixed group of threads that meet at
+	the end of every phase. It can be reused at once for the next phase,
+	so worker threads stay alive across phases instead of being joined and
+	restarted.
+*/
+
+#ifndef TBC_BARRIER_HPP
+#define TBC_BARRIER_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Futex.hpp"
+#include "tbc/Function.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Barrier class
+	// -------------------------------------------------------------------------
+	//	The last thread to arrive runs the completion callback, re-arms the
+	//	arrival count and then advances mPhase, which releases the others.
+	//	Waiters only compare mPhase with the value they saw on arrival
+	//	(sense reversal with a counter instead of a flag), so a fast thread
+	//	that arrives for the next phase cannot be confused with a slow one
+	//	still leaving this phase.
+	class	Barrier
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Barrier(uint32_t inCount, Function<void ()> inCompletion = Function<void ()>())
+									: mCompletion(std::move(inCompletion))
+								{
+									if (inCount == 0)
+									{
+										throw SyncObjectException( Exception::PARAM_ERROR,
+														"inCount == 0", TBC_EXCEPTION_LOCATION_MACRO);
+									}
+									mCount = inCount;
+									mRemaining.store(inCount, std::memory_order_relaxed);
+									mPhase.store(0, std::memory_order_relaxed);
+									mWaiterNum.store(0, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Returns true in the one thread that completed the phase. The
+		//	completion callback runs in that thread before anyone is released.
+		//	If it throws, the phase is still completed and the others are
+		//	released; the exception then propagates from this call only.
+		bool					arriveAndWait()
+		{
+			uint32_t	phase = mPhase.load(std::memory_order_acquire);
+			if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				try
+				{
+					if (mCompletion)
+						mCompletion();
+				}
+				catch (...)
+				{
+					completePhase(phase);
+					throw;
+				}
+				completePhase(phase);
+				return true;
+			}
+
+			for (int i = 0; i < SPIN_NUM; i++)
+			{
+				if (mPhase.load(std::memory_order_acquire) != phase)
+					return false;
+				Futex::cpuRelax();
+			}
+
+			mWaiterNum.fetch_add(1, std::memory_order_seq_cst);
+			while (mPhase.load(std::memory_order_acquire) == phase)
+				Futex::wait(&mPhase, phase);
+			mWaiterNum.fetch_sub(1, std::memory_order_relaxed);
+			return false;
+		}
+		uint32_t				getCount() const
+		{
+			return mCount;
+		}
+		//	Number of phases completed so far (wraps around)
+		uint32_t				getPhase() const
+		{
+			return mPhase.load(std::memory_order_acquire);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static int		SPIN_NUM							= 1000;
+
+		// Member Functions ----------------------------------------------------
+		void					completePhase(uint32_t inPhase)
+		{
+			mRemaining.store(mCount, std::memory_order_relaxed);
+			mPhase.store(inPhase + 1, std::memory_order_seq_cst);
+			if (mWaiterNum.load(std::memory_order_seq_cst) != 0)
+				Futex::wakeAll(&mPhase);
+		}
+
+		// Member Variables ----------------------------------------------------
+		uint32_t				mCount;
+		Function<void ()>		mCompletion;
+		std::atomic<uint32_t>	mRemaining;
+		std::atomic<uint32_t>	mPhase;
+		std::atomic<uint32_t>	mWaiterNum;
+
+								Barrier(const Barrier &);
+		Barrier					&operator=(const Barrier &);
+	};
+}
+
+#endif // TBC_BARRIER_HPP
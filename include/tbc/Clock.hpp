@@ -0,0 +1,273 @@
+// =============================================================================
+//  Clock.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Clock.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc monotonic clock
+
+	This file defines a monotonic nanosecond clock. getNanoseconds() never
+	jumps with wall clock adjustments and does not wrap. getFastNanoseconds()
+	reads the CPU time stamp counter instead once calibrateTsc() succeeded.
+*/
+
+#ifndef TBC_CLOCK_HPP
+#define TBC_CLOCK_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#if defined(__x86_64__) || defined(_M_X64)
+ #define TBC_CLOCK_HAS_TSC
+ #ifdef _MSC_VER
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+  #include <cpuid.h>
+ #endif
+#endif
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+//	none
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <time.h>
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Clock class
+	// -------------------------------------------------------------------------
+	class	Clock
+	{
+	public:
+		// Constatns -----------------------------------------------------------
+		const static uint64_t	NANO_SECOND_UNIT					= 1000000000ULL;
+		const static uint64_t	MICRO_SECOND_UNIT					= 1000000ULL;
+		const static uint64_t	MILLI_SECOND_UNIT					= 1000ULL;
+		const static uint64_t	TIME_INFINITE						= 0xFFFFFFFFFFFFFFFFULL;
+
+		// Static Functions ----------------------------------------------------
+		static uint64_t			getNanoseconds()
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			LARGE_INTEGER	count;
+			uint64_t		freq = getPerformanceFrequency();
+
+			::QueryPerformanceCounter(&count);
+			return ((uint64_t )count.QuadPart / freq) * NANO_SECOND_UNIT +
+					((uint64_t )count.QuadPart % freq) * NANO_SECOND_UNIT / freq;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			struct timespec	t;
+
+			clock_gettime(CLOCK_MONOTONIC, &t);
+			return (uint64_t )t.tv_sec * NANO_SECOND_UNIT + (uint64_t )t.tv_nsec;
+		#endif	// specific parts end ------------------------------------------
+		}
+		static uint64_t			getMicroseconds()
+		{
+			return getNanoseconds() / (NANO_SECOND_UNIT / MICRO_SECOND_UNIT);
+		}
+		static uint64_t			getMilliseconds()
+		{
+			return getNanoseconds() / (NANO_SECOND_UNIT / MILLI_SECOND_UNIT);
+		}
+
+		//	Same time base as getNanoseconds(), but read from the time stamp
+		//	counter once calibrateTsc() succeeded (a few ns instead of a vDSO
+		//	call). The TSC path is only used on CPUs with an invariant TSC.
+		//	Falls back to getNanoseconds() otherwise.
+		static uint64_t			getFastNanoseconds()
+		{
+		#ifdef TBC_CLOCK_HAS_TSC
+			TscState	&state = getTscState();
+
+			if (state.mIsCalibrated.load(std::memory_order_acquire) == false)
+				return getNanoseconds();
+
+			uint64_t	ticks = readTsc();
+			if (ticks < state.mBaseTicks)
+				return state.mBaseNanoseconds;
+			return state.mBaseNanoseconds + mulShift32(ticks - state.mBaseTicks, state.mMultiplier);
+		#else
+			return getNanoseconds();
+		#endif
+		}
+		//	Measures the TSC rate against getNanoseconds() over inMilliseconds.
+		//	Returns false (and keeps the slow path) if the CPU has no invariant
+		//	TSC. Call it once at start-up, before other threads use
+		//	getFastNanoseconds(). inMilliseconds is capped at one second.
+		static bool				calibrateTsc(unsigned int inMilliseconds = 10)
+		{
+		#ifdef TBC_CLOCK_HAS_TSC
+			if (hasInvariantTsc() == false)
+				return false;
+			if (inMilliseconds > MAX_CALIBRATION_MILLISECONDS)
+				inMilliseconds = MAX_CALIBRATION_MILLISECONDS;
+
+			uint64_t	startNs, startTicks, endNs, endTicks;
+			readPair(&startNs, &startTicks);
+			uint64_t	until = startNs + inMilliseconds * (NANO_SECOND_UNIT / MILLI_SECOND_UNIT);
+			do
+			{
+				sleepShortly();
+				readPair(&endNs, &endTicks);
+			}
+			while (endNs < until);
+
+			//	The 32.32 multiplier shifts the elapsed time left by 32 bits,
+			//	which only fits below about 4.29 s (a long preemption could
+			//	still get there)
+			if (endTicks <= startTicks || endNs - startNs > MAX_CALIBRATION_NANOSECONDS)
+				return false;
+
+			TscState	&state = getTscState();
+			state.mIsCalibrated.store(false, std::memory_order_release);
+			state.mMultiplier = ((endNs - startNs) << 32) / (endTicks - startTicks);
+			state.mBaseTicks = endTicks;
+			state.mBaseNanoseconds = endNs;
+			state.mIsCalibrated.store(true, std::memory_order_release);
+			return true;
+		#else
+			return false;
+		#endif
+		}
+		static bool				isTscCalibrated()
+		{
+		#ifdef TBC_CLOCK_HAS_TSC
+			return getTscState().mIsCalibrated.load(std::memory_order_acquire);
+		#else
+			return false;
+		#endif
+		}
+
+	#if _PTHREAD	//	pthread specific ---------------------------------------
+		static void				toTimespec(uint64_t inNanoseconds, struct timespec *outTime)
+		{
+			outTime->tv_sec = (time_t )(inNanoseconds / NANO_SECOND_UNIT);
+			outTime->tv_nsec = (long )(inNanoseconds % NANO_SECOND_UNIT);
+		}
+	#endif			// specific parts end --------------------------------------
+
+	private:
+	#ifdef TBC_CLOCK_HAS_TSC
+		// ---------------------------------------------------------------------
+		// TscState struct
+		// ---------------------------------------------------------------------
+		struct	TscState
+		{
+			std::atomic<bool>	mIsCalibrated;
+			uint64_t			mMultiplier;		// ns per tick, 32.32 fixed point
+			uint64_t			mBaseTicks;
+			uint64_t			mBaseNanoseconds;
+		};
+
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	MAX_CALIBRATION_MILLISECONDS	= 1000;
+		const static uint64_t	MAX_CALIBRATION_NANOSECONDS			= 0xFFFFFFFFULL;
+
+		// Static Functions ----------------------------------------------------
+		static TscState			&getTscState()
+		{
+			static TscState	sState = { {false}, 0, 0, 0 };
+			return sState;
+		}
+		static uint64_t			readTsc()
+		{
+			return (uint64_t )__rdtsc();
+		}
+		static bool				hasInvariantTsc()
+		{
+		#ifdef _MSC_VER
+			int		regs[4];
+
+			__cpuid(regs, 0x80000000);
+			if ((unsigned int )regs[0] < 0x80000007)
+				return false;
+			__cpuid(regs, 0x80000007);
+			return (regs[3] & (1 << 8)) != 0;
+		#else
+			unsigned int	eax, ebx, ecx, edx;
+
+			if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+				return false;
+			if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+				return false;
+			return (edx & (1 << 8)) != 0;
+		#endif
+		}
+		//	Reads the clock and the TSC as close together as possible; the
+		//	pair with the shortest clock read wins.
+		static void				readPair(uint64_t *outNanoseconds, uint64_t *outTicks)
+		{
+			uint64_t	best = TIME_INFINITE;
+
+			for (int i = 0; i < 5; i++)
+			{
+				uint64_t	t0 = readTsc();
+				uint64_t	ns = getNanoseconds();
+				uint64_t	t1 = readTsc();
+
+				if (t1 - t0 < best)
+				{
+					best = t1 - t0;
+					*outNanoseconds = ns;
+					*outTicks = t0 + (t1 - t0) / 2;
+				}
+			}
+		}
+		static uint64_t			mulShift32(uint64_t inValue, uint64_t inMultiplier)
+		{
+		#ifdef _MSC_VER
+			uint64_t	high;
+			uint64_t	low = _umul128(inValue, inMultiplier, &high);
+			return (high << 32) | (low >> 32);
+		#else
+			return (uint64_t )(((unsigned __int128 )inValue * inMultiplier) >> 32);
+		#endif
+		}
+		static void				sleepShortly()
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::Sleep(1);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			struct timespec	reqTime;
+
+			reqTime.tv_sec = 0;
+			reqTime.tv_nsec = 1000000;
+			nanosleep(&reqTime, NULL);
+		#endif	// specific parts end ------------------------------------------
+		}
+	#endif
+
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		static uint64_t			getPerformanceFrequency()
+		{
+			static uint64_t	sFrequency = 0;
+
+			if (sFrequency == 0)
+			{
+				LARGE_INTEGER	freq;
+
+				::QueryPerformanceFrequency(&freq);
+				sFrequency = (uint64_t )freq.QuadPart;
+			}
+			return sFrequency;
+		}
+	#endif			// specific parts end --------------------------------------
+	};
+}
+
+#endif // TBC_CLOCK_HPP
@@ -0,0 +1,206 @@
+// =============================================================================
+//  CpuSet.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/CpuSet.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc CPU affinity set
+
+	This file defines a fixed-size CPU set used for thread affinity and
+	NUMA node placement.
+*/
+
+#ifndef TBC_CPU_SET_HPP
+#define TBC_CPU_SET_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+//	none
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <sched.h>
+ #ifdef __linux__
+  #define TBC_CPU_SET_HAS_NATIVE
+ #endif
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// CpuSet class
+	// -------------------------------------------------------------------------
+	class	CpuSet
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								CpuSet()
+								{
+									clearAll();
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					set(unsigned int inCpu)
+		{
+			if (inCpu >= MAX_CPU_NUM)
+				return;
+			mBits[inCpu / WORD_BITS] |= ((uint64_t )1 << (inCpu % WORD_BITS));
+		}
+		void					clear(unsigned int inCpu)
+		{
+			if (inCpu >= MAX_CPU_NUM)
+				return;
+			mBits[inCpu / WORD_BITS] &= ~((uint64_t )1 << (inCpu % WORD_BITS));
+		}
+		bool					isSet(unsigned int inCpu) const
+		{
+			if (inCpu >= MAX_CPU_NUM)
+				return false;
+			return (mBits[inCpu / WORD_BITS] & ((uint64_t )1 << (inCpu % WORD_BITS))) != 0;
+		}
+		void					clearAll()
+		{
+			::memset(mBits, 0, sizeof(mBits));
+		}
+		bool					isEmpty() const
+		{
+			for (unsigned int i = 0; i < WORD_NUM; i++)
+				if (mBits[i] != 0)
+					return false;
+			return true;
+		}
+		unsigned int			count() const
+		{
+			unsigned int	num = 0;
+			for (unsigned int i = 0; i < MAX_CPU_NUM; i++)
+				if (isSet(i) != false)
+					num++;
+			return num;
+		}
+
+		//	Replaces the set with the CPUs of a NUMA node. Returns false if the
+		//	node topology is not available.
+		bool					setNumaNode(int inNode)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			ULONGLONG	mask;
+
+			if (inNode < 0 || ::GetNumaNodeProcessorMask((UCHAR )inNode, &mask) == false)
+				return false;
+
+			clearAll();
+			mBits[0] = (uint64_t )mask;
+			return true;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			char	path[64];
+			char	buf[1024];
+
+			if (inNode < 0)
+				return false;
+			snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", inNode);
+
+			FILE	*file = fopen(path, "r");
+			if (file == NULL)
+				return false;
+			if (fgets(buf, sizeof(buf), file) == NULL)
+			{
+				fclose(file);
+				return false;
+			}
+			fclose(file);
+
+			return parseCpuList(buf);
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Parses a kernel style CPU list such as "0-3,8,10-11"
+		bool					parseCpuList(const char *inList)
+		{
+			clearAll();
+
+			const char	*p = inList;
+			while (*p != 0 && *p != '\n')
+			{
+				char			*endPtr;
+				unsigned long	first, last;
+
+				first = strtoul(p, &endPtr, 10);
+				if (endPtr == p)
+					return false;
+				last = first;
+				p = endPtr;
+				if (*p == '-')
+				{
+					p++;
+					last = strtoul(p, &endPtr, 10);
+					if (endPtr == p)
+						return false;
+					p = endPtr;
+				}
+
+				for (unsigned long i = first; i <= last && i < MAX_CPU_NUM; i++)
+					set((unsigned int )i);
+
+				if (*p == ',')
+					p++;
+			}
+
+			return true;
+		}
+
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		DWORD_PTR				getAffinityMask() const
+		{
+			return (DWORD_PTR )mBits[0];
+		}
+		void					setAffinityMask(DWORD_PTR inMask)
+		{
+			clearAll();
+			mBits[0] = (uint64_t )inMask;
+		}
+	#elif defined(TBC_CPU_SET_HAS_NATIVE)	//	Linux specific ---------------------
+		//	cpu_set_t and the *affinity_np() functions are Linux only
+		void					getNativeCpuSet(cpu_set_t *outSet) const
+		{
+			CPU_ZERO(outSet);
+			for (unsigned int i = 0; i < MAX_CPU_NUM && i < CPU_SETSIZE; i++)
+				if (isSet(i) != false)
+					CPU_SET(i, outSet);
+		}
+		void					setNativeCpuSet(const cpu_set_t *inSet)
+		{
+			clearAll();
+			for (unsigned int i = 0; i < MAX_CPU_NUM && i < CPU_SETSIZE; i++)
+				if (CPU_ISSET(i, inSet))
+					set(i);
+		}
+	#endif			// specific parts end --------------------------------------
+
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	MAX_CPU_NUM						= 1024;
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	WORD_BITS						= 64;
+		const static unsigned int	WORD_NUM						= MAX_CPU_NUM / WORD_BITS;
+
+		// Member Variables ----------------------------------------------------
+		uint64_t				mBits[WORD_NUM];
+	};
+}
+
+#endif // TBC_CPU_SET_HPP
@@ -0,0 +1,127 @@
+// =============================================================================
+//  Deadline.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Deadline.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc deadline
+
+	This file defines an absolute point in time on the tbc::Clock
+	(monotonic) time base. It is used to carry a timeout through several
+	waits without accumulating error.
+*/
+
+#ifndef TBC_DEADLINE_HPP
+#define TBC_DEADLINE_HPP
+
+// Includes --------------------------------------------------------------------
+#include "tbc/Clock.hpp"
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Deadline class
+	// -------------------------------------------------------------------------
+	class	Deadline
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+		//	The default deadline never expires
+								Deadline()
+								{
+									mTime = Clock::TIME_INFINITE;
+								}
+		explicit				Deadline(uint64_t inNanoseconds)
+								{
+									mTime = inNanoseconds;
+								}
+
+		// Member Functions ----------------------------------------------------
+		bool					isInfinite() const
+		{
+			return (mTime == Clock::TIME_INFINITE);
+		}
+		bool					isExpired() const
+		{
+			if (isInfinite() != false)
+				return false;
+			return Clock::getNanoseconds() >= mTime;
+		}
+		//	Absolute monotonic time of the deadline in nanoseconds
+		uint64_t				getTime() const
+		{
+			return mTime;
+		}
+		//	Nanoseconds left; 0 once expired, Clock::TIME_INFINITE if infinite
+		uint64_t				getRemaining() const
+		{
+			if (isInfinite() != false)
+				return Clock::TIME_INFINITE;
+
+			uint64_t	now = Clock::getNanoseconds();
+			if (now >= mTime)
+				return 0;
+			return mTime - now;
+		}
+		//	Milliseconds left rounded up, so a wait never ends early
+		uint64_t				getRemainingMilliseconds() const
+		{
+			uint64_t	remaining = getRemaining();
+			if (remaining == Clock::TIME_INFINITE)
+				return Clock::TIME_INFINITE;
+
+			const uint64_t	unit = Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT;
+			return (remaining + unit - 1) / unit;
+		}
+	#if _PTHREAD	//	pthread specific ---------------------------------------
+		//	Absolute CLOCK_MONOTONIC time for clock_nanosleep(TIMER_ABSTIME),
+		//	futex waits and condition variables set to CLOCK_MONOTONIC
+		void					getTimespec(struct timespec *outTime) const
+		{
+			Clock::toTimespec(mTime, outTime);
+		}
+	#endif			// specific parts end --------------------------------------
+
+		// Static Functions ----------------------------------------------------
+		static Deadline			fromNow(uint64_t inNanoseconds)
+		{
+			if (inNanoseconds == Clock::TIME_INFINITE)
+				return Deadline();
+
+			uint64_t	now = Clock::getNanoseconds();
+			if (Clock::TIME_INFINITE - now <= inNanoseconds)
+				return Deadline();
+			return Deadline(now + inNanoseconds);
+		}
+		static Deadline			fromMilliseconds(uint64_t inMilliseconds)
+		{
+			const uint64_t	unit = Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT;
+
+			if (inMilliseconds >= Clock::TIME_INFINITE / unit)
+				return Deadline();
+			return fromNow(inMilliseconds * unit);
+		}
+		static Deadline			infinite()
+		{
+			return Deadline();
+		}
+
+	private:
+		// Member Variables ----------------------------------------------------
+		uint64_t				mTime;
+	};
+}
+
+#endif // TBC_DEADLINE_HPP
@@ -24,8 +24,19 @@
 #define TBC_EVENT_H
 
 // Includes --------------------------------------------------------------------
-#include "tbc/SyncObjectException.h"
-#include "tbc/Thread.h"
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#include <stdint.h>
+#include "tbc/Deadline.hpp"
+#ifdef _PTHREAD
+ #include <atomic>
+ #include "tbc/Futex.hpp"
+ #ifdef __linux__
+  #define TBC_EVENT_HAS_POLL_HANDLE
+  #include <unistd.h>
+  #include <sys/eventfd.h>
+ #endif
+#endif
 
 
 // Namespace -------------------------------------------------------------------
@@ -34,20 +45,34 @@ namespace tbc
 	// -------------------------------------------------------------------------
 	// Throwable interface class
 	// -------------------------------------------------------------------------
+	//	The pthread implementation keeps the event in one state word: the
+	//	signaled and pulsed flags plus the number of sleeping waiters. With
+	//	no waiters signal() is a single atomic operation. A waiter that finds
+	//	the event unset spins briefly and then sleeps on a futex word that
+	//	signal() and pulse() bump only when somebody is waiting.
 	class	Event
 	{
 	public:
+		// Constatns -----------------------------------------------------------
+		const static int		WAIT_TIMEOUT_INDEX					= -1;
+		const static int		MAX_WAIT_EVENT_NUM					= 64;
+
 		// Constructors and Destructor -----------------------------------------
-								Event(bool inIsManualReset = false)
+								//	inIsProcessShared makes the event usable from
+								//	several processes when it is placed in shared
+								//	memory (see SharedObject). pthread only.
+								Event(bool inIsManualReset = false, bool inIsProcessShared = false)
 								{
 								#ifdef _WIN32	//	Win32 specific -------------
 									mEvent = ::CreateEvent(NULL, false, inIsManualReset, NULL);
 								#elif _PTHREAD	//	pthread specific -----------
 									mIsManualReset = inIsManualReset;
-									mIsSignaled = false;
-									mIsPulsed = false;
-									mMutexInitError = pthread_mutex_init(&mMutex, NULL);
-									mCondInitError = pthread_cond_init(&mCond, NULL);
+									mIsProcessShared = inIsProcessShared;
+									mState.store(0, std::memory_order_relaxed);
+									mSequence.store(0, std::memory_order_relaxed);
+									mWaitList.store(NULL, std::memory_order_relaxed);
+									mIsWaitListLocked.store(false, std::memory_order_relaxed);
+									mPollHandle.store(-1, std::memory_order_relaxed);
 								#endif	// specific parts end ------------------
 								}
 								~Event()
@@ -55,11 +80,10 @@ namespace tbc
 								#ifdef _WIN32	//	Win32 specific -------------
 									if (mEvent != NULL)
 										::CloseHandle(mEvent);
-								#elif _PTHREAD	//	pthread specific -----------
-									if (mMutexInitError == 0)
-										pthread_mutex_destroy(&mMutex);
-									if (mCondInitError == 0)
-										pthread_cond_destroy(&mCond);
+								#elif defined(TBC_EVENT_HAS_POLL_HANDLE)
+									int	handle = mPollHandle.load(std::memory_order_relaxed);
+									if (handle >= 0)
+										::close(handle);
 								#endif	// specific parts end ------------------
 								}
 
@@ -98,108 +122,36 @@ namespace tbc
 
 			return true;
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-			if (mMutexInitError != 0)
-			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_mutex_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
-			}
-			if (mCondInitError != 0)
-			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_cond_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
-			}
-
-			bool	isSignaled;
-			int		error;
-
-			error = pthread_mutex_lock(&mMutex);
-			if (error != 0)
-			{
-				throw SyncObjectException( Exception::OS_ERROR,
-						"pthread_mutex_lock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-			}
-
-			if (mIsSignaled == true)
-			{
-				if (mIsManualReset == false)
-					mIsSignaled = false;
-				
-				error = pthread_mutex_unlock(&mMutex);
-				if (error != 0)
-				{
-					throw SyncObjectException( Exception::OS_ERROR,
-							"pthread_mutex_unlock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-				}
-				return true;
-			}
-
-			if (inMilliseconds == Thread::WAIT_INFINITE)
-			{
-				while (mIsSignaled == false)
-				{
-					error = pthread_cond_wait(&mCond, &mMutex);
-					if (error != 0)
-					{
-						pthread_mutex_unlock(&mMutex);
-						throw SyncObjectException( Exception::OS_ERROR,
-								"pthread_cond_wait() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-					}
-					
-					if (mIsPulsed != false)
-						break;
-				}
-				isSignaled = true;
-			}
-			else
-			{
-				struct timespec waitUntil;
-				
-				error = Thread::getUnixTimeout(&waitUntil, inMilliseconds);
-				if (error != 0)
-				{
-					pthread_mutex_unlock(&mMutex);
-					throw SyncObjectException( Exception::OS_ERROR,
-							"Thread::getUnixTimeout() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-				}
-
-				while (mIsSignaled == false)
-				{
-					error = pthread_cond_timedwait(&mCond, &mMutex, &waitUntil);
-					if (error == 0)
-						isSignaled = true;
-					else
-					{
-						if (error == ETIMEDOUT)
-						{
-							isSignaled = false;
-							break;
-						}
-						else
-						{
-							pthread_mutex_unlock(&mMutex);
-							throw SyncObjectException( Exception::OS_ERROR,
-									"pthread_cond_wait() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-						}
-					}
-					if (mIsPulsed != false)
-						break;
-				}
-			}
+			return waitNative(getDeadline(inMilliseconds));
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Nanosecond timeout measured on the monotonic clock, so clock
+		//	steps do not shorten or stretch it
+		bool					waitFor(uint64_t inNanoseconds)
+		{
+			return waitUntil(Deadline::fromNow(inNanoseconds));
+		}
+		//	inDeadline is an absolute monotonic time (see tbc::Deadline)
+		bool					waitUntil(const Deadline &inDeadline)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			if (inDeadline.isInfinite() != false)
+				return timedWait(Thread::WAIT_INFINITE);
 
-			if (isSignaled == true && mIsManualReset == false)
+			//	The remaining time is rounded up to milliseconds; loop in
+			//	case WaitForSingleObject() wakes up before the deadline
+			for (;;)
 			{
-				mIsSignaled = false;
-				mIsPulsed = false;
+				uint64_t	remaining = inDeadline.getRemainingMilliseconds();
+				if (remaining >= (uint64_t )INFINITE)
+					remaining = INFINITE - 1;
+				if (timedWait((timeout_t )remaining) != false)
+					return true;
+				if (inDeadline.isExpired() != false)
+					return false;
 			}
-
-			error = pthread_mutex_unlock(&mMutex);
-			if (error != 0)
-			{
-				throw SyncObjectException( Exception::OS_ERROR,
-						"pthread_mutex_unlock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
-			}
-
-			return isSignaled;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			return waitNative(inDeadline);
 		#endif	// specific parts end ------------------------------------------
 		}
 		void					signal()
@@ -217,7 +169,9 @@ namespace tbc
 						"::SetEvent(mEvent) == false", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
 			}
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-			pthread_cond_signal(false);
+			uint32_t	state = mState.fetch_or(SIGNALED, std::memory_order_seq_cst);
+			if ((state & SIGNALED) == 0 && state >= POLLED)
+				wake();
 		#endif	// specific parts end ------------------------------------------
 		}
 		void					pulse()
@@ -235,9 +189,64 @@ namespace tbc
 						"::PulseEvent(mEvent) == false", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
 			}
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-			pthread_cond_signal(true);
+			//	Releases the threads waiting right now (one of them for an
+			//	auto-reset event) and leaves the event unset
+			uint32_t	state = mState.load(std::memory_order_seq_cst);
+			if (state < WAITER_UNIT)
+				return;
+			if (mIsManualReset == false)
+				mState.fetch_or(PULSED, std::memory_order_seq_cst);
+			wake();
 		#endif	// specific parts end ------------------------------------------
 		}
+	#ifdef TBC_EVENT_HAS_POLL_HANDLE
+		//	Returns an eventfd that becomes readable on every signal(), so
+		//	the event can be watched by epoll or poll next to sockets and
+		//	devices (see Reactor). The fd only reports that the event may be
+		//	set: drain it with clearPollHandle() and then take the event
+		//	with timedWait(0). pulse() is not reported. The fd is created on
+		//	first use; from then on every signal() costs one write().
+		int						getPollHandle()
+		{
+			int	handle = mPollHandle.load(std::memory_order_acquire);
+			if (handle >= 0)
+				return handle;
+			if (mIsProcessShared != false)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"A process-shared event has no poll handle", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			int	newHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (newHandle < 0)
+			{
+				throw SyncObjectException( Exception::OS_ERROR,
+						"eventfd() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+			}
+			if (mPollHandle.compare_exchange_strong(handle, newHandle,
+						std::memory_order_acq_rel, std::memory_order_acquire) == false)
+			{
+				::close(newHandle);
+				return handle;
+			}
+
+			//	From now on signal() always wakes; report a signal that came
+			//	before
+			if ((mState.fetch_or(POLLED, std::memory_order_seq_cst) & SIGNALED) != 0)
+				notifyPollHandle();
+			return newHandle;
+		}
+		void					clearPollHandle()
+		{
+			int	handle = mPollHandle.load(std::memory_order_acquire);
+			if (handle >= 0)
+			{
+				uint64_t	value;
+				while (::read(handle, &value, sizeof(value)) < 0 && errno == EINTR)
+					;
+			}
+		}
+	#endif
 		void					reset()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
@@ -253,110 +262,395 @@ namespace tbc
 						"::ResetEvent(mEvent) == false", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
 			}
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-			if (mMutexInitError != 0)
+			mState.fetch_and(~(SIGNALED | PULSED), std::memory_order_seq_cst);
+		#endif	// specific parts end ------------------------------------------
+		}
+
+		// Static Functions ----------------------------------------------------
+		//	Waits until one of the events is signaled and returns its index
+		//	(the lowest one if several are), or WAIT_TIMEOUT_INDEX. An
+		//	auto-reset event is reset only if its index is returned.
+		static int				waitAny(Event *const *inEvents, int inEventNum,
+									timeout_t inMilliseconds = Thread::WAIT_INFINITE)
+		{
+			checkWaitParams(inEvents, inEventNum);
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			HANDLE	handles[MAX_WAIT_EVENT_NUM];
+			for (int i = 0; i < inEventNum; i++)
+				handles[i] = inEvents[i]->mEvent;
+
+			DWORD	result = waitForHandles(handles, inEventNum, FALSE, inMilliseconds);
+			if (result == WAIT_TIMEOUT)
+				return WAIT_TIMEOUT_INDEX;
+			return (int )(result - WAIT_OBJECT_0);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			for (int i = 0; i < inEventNum; i++)
 			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_mutex_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
+				if (inEvents[i]->tryConsume(false) != false)
+					return i;
 			}
-			if (mCondInitError != 0)
+			if (inMilliseconds == 0)
+				return WAIT_TIMEOUT_INDEX;
+
+			Deadline				deadline = getDeadline(inMilliseconds);
+			std::atomic<uint32_t>	word(0);
+			WaitNode				nodes[MAX_WAIT_EVENT_NUM];
+			int						result = WAIT_TIMEOUT_INDEX;
+
+			for (int i = 0; i < inEventNum; i++)
+				inEvents[i]->addWaitNode(&nodes[i], &word);
+
+			//	The word is read before the events are checked, so a wake in
+			//	between makes the futex wait return at once
+			for (bool isTimedOut = false; ; )
 			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_cond_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
+				uint32_t	sequence = word.load(std::memory_order_seq_cst);
+				for (int i = 0; i < inEventNum && result == WAIT_TIMEOUT_INDEX; i++)
+				{
+					if (inEvents[i]->tryConsumeNode(&nodes[i]) != false)
+						result = i;
+				}
+				if (result != WAIT_TIMEOUT_INDEX || isTimedOut != false)
+					break;
+				if (Futex::waitUntil(&word, sequence, deadline) == ETIMEDOUT ||
+					deadline.isExpired() != false)
+					isTimedOut = true;
 			}
 
-			error = pthread_mutex_lock(&mMutex);
-			if (error != 0)
+			for (int i = 0; i < inEventNum; i++)
+				inEvents[i]->removeWaitNode(&nodes[i]);
+			return result;
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Waits until every event has been signaled. On pthread systems
+		//	each auto-reset event is reset as soon as its signal is seen,
+		//	not all at once as on Win32; on timeout those signals are given
+		//	back by signaling the events again.
+		static bool				waitAll(Event *const *inEvents, int inEventNum,
+									timeout_t inMilliseconds = Thread::WAIT_INFINITE)
+		{
+			checkWaitParams(inEvents, inEventNum);
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			HANDLE	handles[MAX_WAIT_EVENT_NUM];
+			for (int i = 0; i < inEventNum; i++)
+				handles[i] = inEvents[i]->mEvent;
+
+			return (waitForHandles(handles, inEventNum, TRUE, inMilliseconds) != WAIT_TIMEOUT);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			bool	isDone[MAX_WAIT_EVENT_NUM];
+			int		remaining = inEventNum;
+
+			for (int i = 0; i < inEventNum; i++)
 			{
-				throw SyncObjectException( Exception::OS_ERROR,
-						"pthread_mutex_lock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				isDone[i] = inEvents[i]->tryConsume(false);
+				if (isDone[i] != false)
+					remaining--;
+			}
+			if (remaining == 0)
+				return true;
+			if (inMilliseconds == 0)
+			{
+				giveBack(inEvents, inEventNum, isDone);
+				return false;
 			}
 
-			mIsSignaled = false;
-			mIsPulsed = false;
+			Deadline				deadline = getDeadline(inMilliseconds);
+			std::atomic<uint32_t>	word(0);
+			WaitNode				nodes[MAX_WAIT_EVENT_NUM];
 
-			error = pthread_mutex_unlock(&mMutex);
-			if (error != 0)
+			for (int i = 0; i < inEventNum; i++)
 			{
-				throw SyncObjectException( Exception::OS_ERROR,
-						"pthread_mutex_unlock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				if (isDone[i] == false)
+					inEvents[i]->addWaitNode(&nodes[i], &word);
+			}
+
+			bool	isTimedOut = false;
+			while (remaining != 0)
+			{
+				uint32_t	sequence = word.load(std::memory_order_seq_cst);
+				for (int i = 0; i < inEventNum; i++)
+				{
+					if (isDone[i] == false && inEvents[i]->tryConsumeNode(&nodes[i]) != false)
+					{
+						isDone[i] = true;
+						remaining--;
+					}
+				}
+				if (remaining == 0 || isTimedOut != false)
+					break;
+				if (Futex::waitUntil(&word, sequence, deadline) == ETIMEDOUT ||
+					deadline.isExpired() != false)
+					isTimedOut = true;
+			}
+
+			for (int i = 0; i < inEventNum; i++)
+			{
+				if (nodes[i].mWord != NULL)
+					inEvents[i]->removeWaitNode(&nodes[i]);
 			}
+
+			if (remaining == 0)
+				return true;
+			giveBack(inEvents, inEventNum, isDone);
+			return false;
 		#endif	// specific parts end ------------------------------------------
 		}
 
 	private:
+		// Static Functions ----------------------------------------------------
+		static void				checkWaitParams(Event *const *inEvents, int inEventNum)
+		{
+			if (inEvents == NULL || inEventNum <= 0 || inEventNum > MAX_WAIT_EVENT_NUM)
+			{
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"inEventNum is out of range", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		#ifdef _PTHREAD
+			for (int i = 0; i < inEventNum; i++)
+			{
+				//	Wait nodes are process-local pointers
+				if (inEvents[i]->mIsProcessShared != false)
+				{
+					throw SyncObjectException( Exception::PARAM_ERROR,
+									"Process-shared events cannot be waited on together",
+									TBC_EXCEPTION_LOCATION_MACRO);
+				}
+			}
+		#endif
+		}
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		static DWORD			waitForHandles(const HANDLE *inHandles, int inHandleNum,
+									BOOL inIsWaitAll, timeout_t inMilliseconds)
+		{
+			if (inMilliseconds == Thread::WAIT_INFINITE)
+				inMilliseconds = INFINITE;
+
+			DWORD	result = ::WaitForMultipleObjects((DWORD )inHandleNum, inHandles, inIsWaitAll, inMilliseconds);
+			if (result >= WAIT_ABANDONED_0 && result < WAIT_ABANDONED_0 + (DWORD )inHandleNum)
+			{
+				throw SyncObjectException( SyncObjectException::WAIT_CANCELED,
+								"result == WAIT_ABANDONED", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			if (result == WAIT_FAILED)
+			{
+				throw SyncObjectException( Exception::OS_ERROR,
+						"::WaitForMultipleObjects() failed", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
+			}
+			return result;
+		}
+	#elif _PTHREAD	//	pthread specific ---------------------------------------
+		static Deadline			getDeadline(timeout_t inMilliseconds)
+		{
+			if (inMilliseconds == Thread::WAIT_INFINITE)
+				return Deadline::infinite();
+			return Deadline::fromMilliseconds(inMilliseconds);
+		}
+		static void				giveBack(Event *const *inEvents, int inEventNum, const bool *inIsDone)
+		{
+			for (int i = 0; i < inEventNum; i++)
+			{
+				if (inIsDone[i] != false && inEvents[i]->mIsManualReset == false)
+					inEvents[i]->signal();
+			}
+		}
+	#endif			// specific parts end --------------------------------------
+
 	#ifdef _WIN32	//	Win32 specific -----------------------------------------
 		// Member Variables ----------------------------------------------------
 		HANDLE					mEvent;
 	#elif _PTHREAD	//	pthread specific ---------------------------------------
+		// Constatns -----------------------------------------------------------
+		const static uint32_t	SIGNALED							= 0x01;
+		const static uint32_t	PULSED								= 0x02;
+		const static uint32_t	POLLED								= 0x04;	//	Has a poll handle
+		const static uint32_t	WAITER_UNIT							= 0x08;
+		const static int		SPIN_NUM							= 100;
+
+		// ---------------------------------------------------------------------
+		// WaitNode class
+		// ---------------------------------------------------------------------
+		//	Registers a waitAny()/waitAll() caller with one event. mWord is
+		//	the caller's futex word, bumped by every wake of the event.
+		struct	WaitNode
+		{
+			std::atomic<uint32_t>	*mWord;
+			uint32_t			mStart;
+			WaitNode			*mPrev;
+			WaitNode			*mNext;
+
+								WaitNode() : mWord(NULL), mStart(0), mPrev(NULL), mNext(NULL) {}
+		};
+
 		// Member Functions ----------------------------------------------------
-		void					pthread_cond_signal(bool inIsPulse = false)
+		bool					waitNative(const Deadline &inDeadline)
 		{
-			if (mMutexInitError != 0)
-			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_mutex_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
-			}
-			if (mCondInitError != 0)
+			if (tryConsume(false) != false)
+				return true;
+			if (inDeadline.isExpired() != false)
+				return false;
+
+			for (int i = 0; i < SPIN_NUM; i++)
 			{
-				throw SyncObjectException( Exception::INTERNAL_ERROR,
-								"pthread_cond_init() failed", TBC_EXCEPTION_LOCATION_MACRO);
+				Futex::cpuRelax();
+				if (tryConsume(false) != false)
+					return true;
 			}
 
-			int		error;
-
-			error = pthread_mutex_lock(&mMutex);
-			if (error != 0)
-				throw MySyncObjectException(
-					MySyncObjectException::OS_ERROR, "pthread_mutex_lock() failed", "MyEvent::Signal", error);
+			//	Read the sequence before registering, so a pulse() that
+			//	counts us as a waiter is also seen by us
+			uint32_t	start = mSequence.load(std::memory_order_seq_cst);
+			uint32_t	sequence = start;
+			mState.fetch_add(WAITER_UNIT, std::memory_order_seq_cst);
 
-			if (mIsManuaReset == false)
+			bool	result;
+			for (;;)
 			{
-				error = pthread_cond_signal(&mCond);
-				if (error != 0)
+				if (tryConsume(true) != false)
 				{
-					pthread_mutex_unlock(&mMutex);
-					throw SyncObjectException( Exception::OS_ERROR,
-							"pthread_cond_broadcast() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					result = true;
+					break;
 				}
-			}
-			else
-			{
-				error = pthread_cond_broadcast(&mCond);
-				if (error != 0)
+				//	A manual-reset event released by pulse(), or signaled
+				//	and reset again, before we saw it
+				if (mIsManualReset != false &&
+					mSequence.load(std::memory_order_acquire) != start)
+				{
+					result = true;
+					break;
+				}
+				if (Futex::waitUntil(&mSequence, sequence, inDeadline, mIsProcessShared) == ETIMEDOUT ||
+					inDeadline.isExpired() != false)
 				{
-					pthread_mutex_unlock(&mMutex);
-					throw SyncObjectException( Exception::OS_ERROR,
-							"pthread_cond_broadcast() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					result = tryConsume(true);
+					break;
 				}
+				sequence = mSequence.load(std::memory_order_acquire);
 			}
-			
-			if (inIsPulse == false)
+			unregisterWaiter();
+			return result;
+		}
+		//	Takes the signal (or a pulse, for a registered auto-reset waiter)
+		bool					tryConsume(bool inIsRegistered)
+		{
+			uint32_t	state = mState.load(std::memory_order_acquire);
+			for (;;)
 			{
-				mIsSignaled = true;
-				mIsPulsed = false;
+				uint32_t	bits = SIGNALED;
+				if (inIsRegistered != false)
+					bits |= PULSED;
+				if ((state & bits) == 0)
+					return false;
+				if (mIsManualReset != false)
+					return true;
+
+				uint32_t	taken = ((state & SIGNALED) != 0) ? SIGNALED : PULSED;
+				if (mState.compare_exchange_weak(state, state & ~taken,
+							std::memory_order_acquire, std::memory_order_acquire) != false)
+					return true;
 			}
-			else
+		}
+		void					unregisterWaiter()
+		{
+			//	A pulse nobody took does not outlive the last waiter
+			uint32_t	state = mState.load(std::memory_order_relaxed);
+			for (;;)
 			{
-				mIsSignaled = false;
-				mIsPulsed = true;
+				uint32_t	next = state - WAITER_UNIT;
+				if (next < WAITER_UNIT)
+					next &= ~PULSED;
+				if (mState.compare_exchange_weak(state, next, std::memory_order_seq_cst) != false)
+					return;
 			}
-			
-			error = pthread_mutex_unlock(&mMutex);
-			if (error != 0)
+		}
+		void					wake()
+		{
+			mSequence.fetch_add(1, std::memory_order_seq_cst);
+			//	Only the poll handle may be listening
+			if (mState.load(std::memory_order_seq_cst) >= WAITER_UNIT)
 			{
-				throw SyncObjectException( Exception::OS_ERROR,
-						"pthread_mutex_unlock() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				if (mIsManualReset != false)
+					Futex::wakeAll(&mSequence, mIsProcessShared);
+				else
+					Futex::wakeOne(&mSequence, mIsProcessShared);
+			}
+
+		#ifdef TBC_EVENT_HAS_POLL_HANDLE
+			notifyPollHandle();
+		#endif
+			if (mWaitList.load(std::memory_order_seq_cst) == NULL)
+				return;
+			lockWaitList();
+			for (WaitNode *node = mWaitList.load(std::memory_order_relaxed); node != NULL; node = node->mNext)
+			{
+				node->mWord->fetch_add(1, std::memory_order_seq_cst);
+				Futex::wakeOne(node->mWord);
+			}
+			unlockWaitList();
+		}
+		//	The node counts as a waiter, so signal() and pulse() call wake().
+		//	It is linked before the count goes up, so wake() finds it.
+		void					addWaitNode(WaitNode *ioNode, std::atomic<uint32_t> *inWord)
+		{
+			ioNode->mWord = inWord;
+			ioNode->mStart = mSequence.load(std::memory_order_seq_cst);
+			lockWaitList();
+			ioNode->mPrev = NULL;
+			ioNode->mNext = mWaitList.load(std::memory_order_relaxed);
+			if (ioNode->mNext != NULL)
+				ioNode->mNext->mPrev = ioNode;
+			mWaitList.store(ioNode, std::memory_order_relaxed);
+			unlockWaitList();
+			mState.fetch_add(WAITER_UNIT, std::memory_order_seq_cst);
+		}
+		void					removeWaitNode(WaitNode *ioNode)
+		{
+			lockWaitList();
+			if (ioNode->mPrev != NULL)
+				ioNode->mPrev->mNext = ioNode->mNext;
+			else
+				mWaitList.store(ioNode->mNext, std::memory_order_relaxed);
+			if (ioNode->mNext != NULL)
+				ioNode->mNext->mPrev = ioNode->mPrev;
+			unlockWaitList();
+			unregisterWaiter();
+		}
+		bool					tryConsumeNode(WaitNode *inNode)
+		{
+			if (tryConsume(true) != false)
+				return true;
+			return (mIsManualReset != false &&
+					mSequence.load(std::memory_order_acquire) != inNode->mStart);
+		}
+	#ifdef TBC_EVENT_HAS_POLL_HANDLE
+		void					notifyPollHandle()
+		{
+			int	handle = mPollHandle.load(std::memory_order_acquire);
+			if (handle >= 0)
+			{
+				uint64_t	one = 1;
+				while (::write(handle, &one, sizeof(one)) < 0 && errno == EINTR)
+					;
 			}
 		}
-		
+	#endif
+		void					lockWaitList()
+		{
+			while (mIsWaitListLocked.exchange(true, std::memory_order_acquire) != false)
+				Futex::cpuRelax();
+		}
+		void					unlockWaitList()
+		{
+			mIsWaitListLocked.store(false, std::memory_order_release);
+		}
+
 		// Member Variables ----------------------------------------------------
 		bool					mIsManualReset;
-		bool					mIsSignaled;
-		bool					mIsPulsed;
-		pthread_mutex_t			mMutex;
-		pthread_cond_t			mCond;
-		int						mMutexInitError;
-		int						mCondInitError;
+		bool					mIsProcessShared;
+		std::atomic<uint32_t>	mState;
+		std::atomic<uint32_t>	mSequence;
+		std::atomic<WaitNode *>	mWaitList;
+		std::atomic<bool>		mIsWaitListLocked;
+		std::atomic<int>		mPollHandle;
 	#endif			// specific parts end --------------------------------------
 };
 
@@ -0,0 +1,226 @@
+// =============================================================================
+//  Function.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Function.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc move-only callable
+
+	This file defines a move-only type-erased callable. Callables up to
+	INLINE_SIZE bytes (a lambda capturing a few pointers) are stored
+	inside the object itself; only larger ones are allocated on the heap.
+*/
+
+#ifndef TBC_FUNCTION_HPP
+#define TBC_FUNCTION_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	template <class Signature>
+	class	Function;
+
+	// -------------------------------------------------------------------------
+	// Function class
+	// -------------------------------------------------------------------------
+	template <class R, class... Args>
+	class	Function<R (Args...)>
+	{
+	public:
+		// Constatns -----------------------------------------------------------
+		const static size_t		INLINE_SIZE							= 6 * sizeof(void *);
+
+		// Constructors and Destructor -----------------------------------------
+								Function()
+								{
+									mOps = NULL;
+								}
+		template <class F, class = typename std::enable_if<
+					std::is_same<typename std::decay<F>::type, Function>::value == false>::type>
+								Function(F &&inFunc)
+								{
+									typedef typename std::decay<F>::type	Type;
+
+									construct<Type>(std::forward<F>(inFunc), IsInline<Type>());
+								}
+								Function(Function &&inFunc)
+								{
+									mOps = inFunc.mOps;
+									if (mOps != NULL)
+									{
+										mOps->mMove(&mStorage, &inFunc.mStorage);
+										inFunc.mOps = NULL;
+									}
+								}
+								~Function()
+								{
+									reset();
+								}
+
+		// Operators -----------------------------------------------------------
+		Function				&operator=(Function &&inFunc)
+		{
+			if (this == &inFunc)
+				return *this;
+
+			reset();
+			mOps = inFunc.mOps;
+			if (mOps != NULL)
+			{
+				mOps->mMove(&mStorage, &inFunc.mStorage);
+				inFunc.mOps = NULL;
+			}
+			return *this;
+		}
+		//	The function must not be empty
+		R						operator()(Args... inArgs)
+		{
+			return mOps->mInvoke(&mStorage, std::forward<Args>(inArgs)...);
+		}
+		explicit				operator bool() const
+		{
+			return (mOps != NULL);
+		}
+
+		// Member Functions ----------------------------------------------------
+		bool					isEmpty() const
+		{
+			return (mOps == NULL);
+		}
+		void					reset()
+		{
+			if (mOps == NULL)
+				return;
+
+			mOps->mDestroy(&mStorage);
+			mOps = NULL;
+		}
+
+	private:
+		// ---------------------------------------------------------------------
+		// Ops struct
+		// ---------------------------------------------------------------------
+		struct	Ops
+		{
+			R					(*mInvoke)(void *inStorage, Args&&... inArgs);
+			void				(*mMove)(void *outStorage, void *ioStorage);
+			void				(*mDestroy)(void *inStorage);
+		};
+
+		// ---------------------------------------------------------------------
+		// InlineOps struct
+		// ---------------------------------------------------------------------
+		template <class F>
+		struct	InlineOps
+		{
+			static R			invoke(void *inStorage, Args&&... inArgs)
+			{
+				return (*(F *)inStorage)(std::forward<Args>(inArgs)...);
+			}
+			static void			move(void *outStorage, void *ioStorage)
+			{
+				new (outStorage) F(std::move(*(F *)ioStorage));
+				((F *)ioStorage)->~F();
+			}
+			static void			destroy(void *inStorage)
+			{
+				((F *)inStorage)->~F();
+			}
+
+			static const Ops	sOps;
+		};
+
+		// ---------------------------------------------------------------------
+		// HeapOps struct
+		// ---------------------------------------------------------------------
+		template <class F>
+		struct	HeapOps
+		{
+			static R			invoke(void *inStorage, Args&&... inArgs)
+			{
+				return (**(F **)inStorage)(std::forward<Args>(inArgs)...);
+			}
+			static void			move(void *outStorage, void *ioStorage)
+			{
+				*(F **)outStorage = *(F **)ioStorage;
+			}
+			static void			destroy(void *inStorage)
+			{
+				delete *(F **)inStorage;
+			}
+
+			static const Ops	sOps;
+		};
+
+		typedef typename std::aligned_storage<INLINE_SIZE, alignof(max_align_t)>::type	Storage;
+
+		// ---------------------------------------------------------------------
+		// IsInline struct
+		// ---------------------------------------------------------------------
+		//	Inline storage needs a move that cannot throw, otherwise moving
+		//	the Function could leave both objects half-moved
+		template <class F>
+		struct	IsInline : public std::integral_constant<bool,
+							sizeof(F) <= INLINE_SIZE &&
+							alignof(F) <= alignof(Storage) &&
+							std::is_nothrow_move_constructible<F>::value>
+		{
+		};
+
+		// Member Functions ----------------------------------------------------
+		template <class F, class G>
+		void					construct(G &&inFunc, std::true_type)
+		{
+			new (&mStorage) F(std::forward<G>(inFunc));
+			mOps = &InlineOps<F>::sOps;
+		}
+		template <class F, class G>
+		void					construct(G &&inFunc, std::false_type)
+		{
+			*(F **)&mStorage = new F(std::forward<G>(inFunc));
+			mOps = &HeapOps<F>::sOps;
+		}
+
+		// Member Variables ----------------------------------------------------
+		Storage					mStorage;
+		const Ops				*mOps;
+	};
+
+	template <class R, class... Args>
+	template <class F>
+	const typename Function<R (Args...)>::Ops	Function<R (Args...)>::InlineOps<F>::sOps =
+	{
+		&Function<R (Args...)>::InlineOps<F>::invoke,
+		&Function<R (Args...)>::InlineOps<F>::move,
+		&Function<R (Args...)>::InlineOps<F>::destroy
+	};
+
+	template <class R, class... Args>
+	template <class F>
+	const typename Function<R (Args...)>::Ops	Function<R (Args...)>::HeapOps<F>::sOps =
+	{
+		&Function<R (Args...)>::HeapOps<F>::invoke,
+		&Function<R (Args...)>::HeapOps<F>::move,
+		&Function<R (Args...)>::HeapOps<F>::destroy
+	};
+}
+
+#endif // TBC_FUNCTION_HPP
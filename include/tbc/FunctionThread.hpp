@@ -0,0 +1,397 @@
+// =============================================================================
+//  FunctionThread.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/FunctionThread.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc callable based thread
+
+	This file defines a movable companion of tbc::Thread that runs a
+	callable instead of a virtual runner(). The callable is stored in a
+	tbc::Function, so small lambdas need no heap allocation.
+*/
+
+#ifndef TBC_FUNCTION_THREAD_HPP
+#define TBC_FUNCTION_THREAD_HPP
+
+// Includes --------------------------------------------------------------------
+#include <atomic>
+#include <utility>
+#include "tbc/ThreadException.hpp"
+#include "tbc/Function.hpp"
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+//	none
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <pthread.h>
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// FunctionThread class
+	// -------------------------------------------------------------------------
+	//	start() hands the runner over to the new thread, which keeps it on
+	//	its own stack while it runs, so the FunctionThread object itself can
+	//	be moved (e.g. inside a std::vector) while the thread is running.
+	//	The runner is handed back when it returns, and start() may be
+	//	called again after join(). The stopper is called by signalStop() on
+	//	the calling thread. Like tbc::Thread, the destructor joins.
+	class	FunctionThread
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								FunctionThread()
+								{
+									init();
+								}
+		explicit				FunctionThread(Function<void ()> inRunner,
+											Function<void ()> inStopper = Function<void ()>())
+									: mRunner(std::move(inRunner)), mStopper(std::move(inStopper))
+								{
+									init();
+								}
+								FunctionThread(FunctionThread &&inThread)
+								{
+									init();
+									moveFrom(inThread);
+								}
+								~FunctionThread()
+								{
+									if (mIsThreadStarted == false)
+										return;
+
+									try
+									{
+										join();
+									}
+
+									catch(...)
+									{
+									}
+								}
+
+		// Operators -----------------------------------------------------------
+		//	A running thread owned by this object is joined first
+		FunctionThread			&operator=(FunctionThread &&inThread)
+		{
+			if (this == &inThread)
+				return *this;
+
+			if (mIsThreadStarted != false)
+				join();
+			moveFrom(inThread);
+			return *this;
+		}
+
+		// Member Functions ----------------------------------------------------
+		//	The runner and the stopper can only be replaced while the thread
+		//	is not running
+		void					setRunner(Function<void ()> inRunner)
+		{
+			checkNotAlive();
+			mRunner = std::move(inRunner);
+		}
+		void					setStopper(Function<void ()> inStopper)
+		{
+			checkNotAlive();
+			mStopper = std::move(inStopper);
+		}
+		void					start()
+		{
+			checkNotAlive();
+			if (mIsThreadStarted != false)
+				join();
+
+			if (mRunner.isEmpty() != false)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"Runner is not set", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			mStripe = getNextStripe();
+			mIsStarting = true;
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			DWORD	threadID;
+			mThread = ::CreateThread(NULL, 0,
+									(LPTHREAD_START_ROUTINE )threadEntryFunc, (LPVOID )this,
+									0, &threadID);
+			if (mThread == NULL)
+			{
+				mIsStarting = false;
+				throw ThreadException( Exception::OS_ERROR,
+						"mThread == NULL", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
+			}
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			int error = pthread_create(&mThread, NULL, threadEntryFunc, (void *)this);
+			if (error != 0)
+			{
+				mIsStarting = false;
+				throw ThreadException( Exception::OS_ERROR,
+						"pthread_create() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+		#endif	// specific parts end ------------------------------------------
+			mIsThreadStarted = true;
+
+			//	Wait until the new thread took the runner; after this the
+			//	object may be moved
+			Stripe	&stripe = getStripe(mStripe);
+			stripe.lock();
+			while (mIsStarting != false)
+				stripe.wait();
+			stripe.unlock();
+		}
+		void					signalStop()
+		{
+			if (mIsThreadStarted == false)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"Thread is not started", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			if (isAlive() == false)
+				return;
+			if (mStopper.isEmpty() == false)
+				mStopper();
+		}
+		void					join()
+		{
+			if (mIsThreadStarted == false)
+			{
+				throw ThreadException( ThreadException::ILLEGAL_THREAD_STATE,
+						"Thread is not started", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			DWORD   result = ::WaitForSingleObject(mThread, INFINITE);
+			if (result != WAIT_OBJECT_0)
+			{
+				throw ThreadException( Exception::OS_ERROR,
+						"result != WAIT_OBJECT_0", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
+			}
+			::CloseHandle(mThread);
+			mThread = NULL;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			int error = pthread_join(mThread, NULL);
+			if (error != 0)
+			{
+				throw ThreadException( Exception::OS_ERROR,
+						"pthread_join() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+		#endif	// specific parts end ------------------------------------------
+			mIsThreadStarted = false;
+		}
+		bool					isAlive() const
+		{
+			if (mIsThreadStarted == false)
+				return false;
+
+			Stripe	&stripe = getStripe(mStripe);
+			stripe.lock();
+			bool	isRunning = (mControl != NULL);
+			stripe.unlock();
+			return isRunning;
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	STRIPE_NUM						= 16;
+
+		// ---------------------------------------------------------------------
+		// Control struct
+		// ---------------------------------------------------------------------
+		//	Lives on the stack of the running thread
+		struct	Control
+		{
+			FunctionThread		*mOwner;
+			Function<void ()>	mRunner;
+		};
+
+		// ---------------------------------------------------------------------
+		// Stripe class
+		// ---------------------------------------------------------------------
+		//	Guards mControl/mRunner of every object hashed to it against the
+		//	running thread, so a move never races with the hand-over
+		class	Stripe
+		{
+		public:
+									Stripe()
+									{
+									#ifdef _WIN32	//	Win32 specific ---------
+										::InitializeSRWLock(&mLock);
+										::InitializeConditionVariable(&mCond);
+									#elif _PTHREAD	//	pthread specific -------
+										pthread_mutex_init(&mMutex, NULL);
+										pthread_cond_init(&mCond, NULL);
+									#endif	// specific parts end --------------
+									}
+
+			void					lock()
+			{
+			#ifdef _WIN32	//	Win32 specific ---------------------------------
+				::AcquireSRWLockExclusive(&mLock);
+			#elif _PTHREAD	//	pthread specific -------------------------------
+				pthread_mutex_lock(&mMutex);
+			#endif	// specific parts end --------------------------------------
+			}
+			void					unlock()
+			{
+			#ifdef _WIN32	//	Win32 specific ---------------------------------
+				::ReleaseSRWLockExclusive(&mLock);
+			#elif _PTHREAD	//	pthread specific -------------------------------
+				pthread_mutex_unlock(&mMutex);
+			#endif	// specific parts end --------------------------------------
+			}
+			void					wait()
+			{
+			#ifdef _WIN32	//	Win32 specific ---------------------------------
+				::SleepConditionVariableSRW(&mCond, &mLock, INFINITE, 0);
+			#elif _PTHREAD	//	pthread specific -------------------------------
+				pthread_cond_wait(&mCond, &mMutex);
+			#endif	// specific parts end --------------------------------------
+			}
+			void					broadcast()
+			{
+			#ifdef _WIN32	//	Win32 specific ---------------------------------
+				::WakeAllConditionVariable(&mCond);
+			#elif _PTHREAD	//	pthread specific -------------------------------
+				pthread_cond_broadcast(&mCond);
+			#endif	// specific parts end --------------------------------------
+			}
+
+		private:
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			SRWLOCK					mLock;
+			CONDITION_VARIABLE		mCond;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			pthread_mutex_t			mMutex;
+			pthread_cond_t			mCond;
+		#endif	// specific parts end ------------------------------------------
+		};
+
+		// Member Functions ----------------------------------------------------
+		void					init()
+		{
+			mControl = NULL;
+			mStripe = 0;
+			mIsStarting = false;
+			mIsThreadStarted = false;
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			mThread = NULL;
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	This object must not own a thread
+		void					moveFrom(FunctionThread &ioThread)
+		{
+			mStopper = std::move(ioThread.mStopper);
+			mIsThreadStarted = ioThread.mIsThreadStarted;
+			mThread = ioThread.mThread;
+			mStripe = ioThread.mStripe;
+
+			Stripe	&stripe = getStripe(mStripe);
+			stripe.lock();
+			{
+				mRunner = std::move(ioThread.mRunner);
+				mControl = ioThread.mControl;
+				if (mControl != NULL)
+					mControl->mOwner = this;
+				ioThread.mControl = NULL;
+			}
+			stripe.unlock();
+
+			ioThread.mIsThreadStarted = false;
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			ioThread.mThread = NULL;
+		#endif	// specific parts end ------------------------------------------
+		}
+		void					checkNotAlive() const
+		{
+			if (isAlive() != false)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"Thread is already started", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		}
+
+		// Static Functions ----------------------------------------------------
+		static Stripe			&getStripe(unsigned int inIndex)
+		{
+			static Stripe	sStripes[STRIPE_NUM];
+			return sStripes[inIndex];
+		}
+		static unsigned int		getNextStripe()
+		{
+			static std::atomic<unsigned int>	sNext(0);
+			return sNext.fetch_add(1, std::memory_order_relaxed) % STRIPE_NUM;
+		}
+		static void				run(FunctionThread *inOwner)
+		{
+			Control	control;
+			Stripe	&stripe = getStripe(inOwner->mStripe);
+
+			stripe.lock();
+			{
+				control.mOwner = inOwner;
+				control.mRunner = std::move(inOwner->mRunner);
+				inOwner->mControl = &control;
+				inOwner->mIsStarting = false;
+				stripe.broadcast();
+			}
+			stripe.unlock();
+
+			control.mRunner();
+
+			stripe.lock();
+			{
+				//	mOwner is kept up to date by moveFrom()
+				if (control.mOwner != NULL)
+				{
+					control.mOwner->mRunner = std::move(control.mRunner);
+					control.mOwner->mControl = NULL;
+				}
+			}
+			stripe.unlock();
+		}
+
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		static DWORD			threadEntryFunc(void *inObjPtr)
+		{
+			run((FunctionThread *)inObjPtr);
+			return 0;
+		}
+	#elif _PTHREAD	//	pthread specific ---------------------------------------
+		static void				*threadEntryFunc(void *inObjPtr)
+		{
+			run((FunctionThread *)inObjPtr);
+			return NULL;
+		}
+	#endif			// specific parts end --------------------------------------
+
+		// Member Variables ----------------------------------------------------
+		Function<void ()>		mRunner;
+		Function<void ()>		mStopper;
+		Control					*mControl;
+		unsigned int			mStripe;
+		bool					mIsStarting;
+		bool					mIsThreadStarted;
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		HANDLE					mThread;
+	#elif _PTHREAD	//	pthread specific ---------------------------------------
+		pthread_t				mThread;
+	#endif			// specific parts end --------------------------------------
+	};
+}
+
+#endif // TBC_FUNCTION_THREAD_HPP
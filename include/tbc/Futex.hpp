@@ -0,0 +1,219 @@
+// =============================================================================
+//  Futex.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Futex.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc futex wrapper
+
+	This file defines a thin wrapper around the Linux futex system call
+	(WaitOnAddress on Win32): block while a 32-bit word holds an expected
+	value, and wake threads blocked on a word. Other pthread systems fall
+	back to short sleeps, which callers see as spurious wake-ups.
+*/
+
+#ifndef TBC_FUTEX_HPP
+#define TBC_FUTEX_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <errno.h>
+#include <atomic>
+#include "tbc/Clock.hpp"
+#include "tbc/Deadline.hpp"
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+ #include <immintrin.h>
+#endif
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+ #pragma comment(lib, "Synchronization.lib")
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <time.h>
+ #include <sched.h>
+ #ifdef __linux__
+  #define TBC_FUTEX_HAS_SYSCALL
+  #include <unistd.h>
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+ #endif
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Futex class
+	// -------------------------------------------------------------------------
+	//	The wait functions return 0 when woken, ETIMEDOUT, or EAGAIN if the
+	//	word did not hold inExpected. Wake-ups may be spurious, so callers
+	//	always re-check the word. inIsShared selects process-shared futexes
+	//	for words in shared memory (Linux only).
+	class	Futex
+	{
+	public:
+		// Static Functions ----------------------------------------------------
+		static int				wait(std::atomic<uint32_t> *inWord, uint32_t inExpected,
+									bool inIsShared = false)
+		{
+			return waitFor(inWord, inExpected, Clock::TIME_INFINITE, inIsShared);
+		}
+		static int				waitFor(std::atomic<uint32_t> *inWord, uint32_t inExpected,
+									uint64_t inNanoseconds, bool inIsShared = false)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			DWORD	ms = INFINITE;
+			if (inNanoseconds != Clock::TIME_INFINITE)
+			{
+				uint64_t	t = (inNanoseconds + 999999) / 1000000;
+				ms = (t >= INFINITE) ? INFINITE - 1 : (DWORD )t;
+			}
+			if (::WaitOnAddress((volatile VOID *)inWord, &inExpected, sizeof(inExpected), ms) != FALSE)
+				return 0;
+			return (::GetLastError() == ERROR_TIMEOUT) ? ETIMEDOUT : 0;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+		#ifdef TBC_FUTEX_HAS_SYSCALL
+			struct timespec	t, *timeout = NULL;
+
+			if (inNanoseconds != Clock::TIME_INFINITE)
+			{
+				Clock::toTimespec(inNanoseconds, &t);
+				timeout = &t;
+			}
+			if (syscall(SYS_futex, (uint32_t *)inWord, getOp(FUTEX_WAIT, inIsShared),
+						inExpected, timeout, NULL, 0) == 0)
+				return 0;
+			return getWaitError();
+		#else
+			return emulateWait(inWord, inExpected, inNanoseconds);
+		#endif
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Waits until an absolute Clock time, so repeated waits after
+		//	spurious wake-ups do not stretch the timeout
+		static int				waitUntil(std::atomic<uint32_t> *inWord, uint32_t inExpected,
+									const Deadline &inDeadline, bool inIsShared = false)
+		{
+			if (inDeadline.isInfinite() != false)
+				return wait(inWord, inExpected, inIsShared);
+
+		#if defined(_PTHREAD) && defined(TBC_FUTEX_HAS_SYSCALL)
+			struct timespec	t;
+
+			inDeadline.getTimespec(&t);
+			if (syscall(SYS_futex, (uint32_t *)inWord, getOp(FUTEX_WAIT_BITSET, inIsShared),
+						inExpected, &t, NULL, FUTEX_BITSET_MATCH_ANY) == 0)
+				return 0;
+			return getWaitError();
+		#else
+			uint64_t	remaining = inDeadline.getRemaining();
+			if (remaining == 0)
+				return ETIMEDOUT;
+			return waitFor(inWord, inExpected, remaining, inIsShared);
+		#endif
+		}
+		static void				wakeOne(std::atomic<uint32_t> *inWord, bool inIsShared = false)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::WakeByAddressSingle((PVOID )inWord);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+		#ifdef TBC_FUTEX_HAS_SYSCALL
+			syscall(SYS_futex, (uint32_t *)inWord, getOp(FUTEX_WAKE, inIsShared), 1, NULL, NULL, 0);
+		#endif
+		#endif	// specific parts end ------------------------------------------
+		}
+		static void				wakeAll(std::atomic<uint32_t> *inWord, bool inIsShared = false)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::WakeByAddressAll((PVOID )inWord);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+		#ifdef TBC_FUTEX_HAS_SYSCALL
+			syscall(SYS_futex, (uint32_t *)inWord, getOp(FUTEX_WAKE, inIsShared), INT32_MAX, NULL, NULL, 0);
+		#endif
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Wakes up to inNum threads, e.g. one per released resource
+		static void				wake(std::atomic<uint32_t> *inWord, uint32_t inNum, bool inIsShared = false)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			for (uint32_t i = 0; i < inNum; i++)
+				::WakeByAddressSingle((PVOID )inWord);
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+		#ifdef TBC_FUTEX_HAS_SYSCALL
+			int	num = (inNum > (uint32_t )INT32_MAX) ? INT32_MAX : (int )inNum;
+			syscall(SYS_futex, (uint32_t *)inWord, getOp(FUTEX_WAKE, inIsShared), num, NULL, NULL, 0);
+		#endif
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Spin-wait hint for busy loops (PAUSE on x86, YIELD on ARM)
+		static void				cpuRelax()
+		{
+		#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+			_mm_pause();
+		#elif defined(__aarch64__) || defined(__arm__)
+			__asm__ __volatile__("yield");
+		#endif
+		}
+		//	Gives up the rest of the time slice, for spin loops that have
+		//	backed off as far as they go
+		static void				yield()
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::SwitchToThread();
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			sched_yield();
+		#endif	// specific parts end ------------------------------------------
+		}
+
+	private:
+	#if defined(_PTHREAD) && defined(TBC_FUTEX_HAS_SYSCALL)
+		// Static Functions ----------------------------------------------------
+		static int				getOp(int inOp, bool inIsShared)
+		{
+			if (inIsShared != false)
+				return inOp;
+			return inOp | FUTEX_PRIVATE_FLAG;
+		}
+		static int				getWaitError()
+		{
+			if (errno == ETIMEDOUT || errno == EAGAIN)
+				return errno;
+			//	EINTR and anything else count as a spurious wake-up
+			return 0;
+		}
+	#elif defined(_PTHREAD)
+		// Static Functions ----------------------------------------------------
+		static int				emulateWait(std::atomic<uint32_t> *inWord, uint32_t inExpected,
+									uint64_t inNanoseconds)
+		{
+			if (inWord->load(std::memory_order_acquire) != inExpected)
+				return EAGAIN;
+			if (inNanoseconds == 0)
+				return ETIMEDOUT;
+
+			struct timespec	t;
+			uint64_t		sleepTime = EMULATED_WAIT_NANOSECONDS;
+			if (sleepTime > inNanoseconds)
+				sleepTime = inNanoseconds;
+			Clock::toTimespec(sleepTime, &t);
+			nanosleep(&t, NULL);
+			return 0;
+		}
+
+		// Constatns -----------------------------------------------------------
+		const static uint64_t	EMULATED_WAIT_NANOSECONDS			= 50000;
+	#endif
+	};
+}
+
+#endif // TBC_FUTEX_HPP
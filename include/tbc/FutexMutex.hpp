@@ -0,0 +1,153 @@
+// =============================================================================
+//  FutexMutex.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/FutexMutex.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc futex mutex
+
+	This file defines a mutex on a single futex word with the same
+	lock()/tryLock()/unlock() interface as tbc::Mutex. Uncontended lock()
+	and unlock() are one atomic instruction each. A contended lock()
+	spins for a while first; the spin length adapts to how long the lock
+	is usually held before the thread sleeps in the kernel.
+*/
+
+#ifndef TBC_FUTEX_MUTEX_HPP
+#define TBC_FUTEX_MUTEX_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#include "tbc/Futex.hpp"
+#include "tbc/Deadline.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// FutexMutex class
+	// -------------------------------------------------------------------------
+	//	The word is UNLOCKED, LOCKED (no sleepers) or CONTENDED (there may be
+	//	sleepers, so unlock() has to wake one). Not recursive.
+	class	FutexMutex
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								FutexMutex()
+								{
+									mState.store(UNLOCKED, std::memory_order_relaxed);
+									mSpinNum.store(INITIAL_SPIN_NUM, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					lock()
+		{
+			uint32_t	state = UNLOCKED;
+			if (mState.compare_exchange_strong(state, LOCKED,
+						std::memory_order_acquire, std::memory_order_relaxed) != false)
+				return;
+
+			lockSlow(Deadline::infinite());
+		}
+		bool					tryLock()
+		{
+			uint32_t	state = UNLOCKED;
+			return mState.compare_exchange_strong(state, LOCKED,
+						std::memory_order_acquire, std::memory_order_relaxed);
+		}
+		//	Returns false if the lock could not be taken within inNanoseconds
+		bool					tryLockFor(uint64_t inNanoseconds)
+		{
+			if (tryLock() != false)
+				return true;
+			return lockSlow(Deadline::fromNow(inNanoseconds));
+		}
+		bool					tryLockUntil(const Deadline &inDeadline)
+		{
+			if (tryLock() != false)
+				return true;
+			return lockSlow(inDeadline);
+		}
+		void					unlock()
+		{
+			if (mState.fetch_sub(1, std::memory_order_release) == LOCKED)
+				return;
+
+			mState.store(UNLOCKED, std::memory_order_release);
+			Futex::wakeOne(&mState);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static uint32_t	UNLOCKED							= 0;
+		const static uint32_t	LOCKED								= 1;
+		const static uint32_t	CONTENDED							= 2;
+		const static int		INITIAL_SPIN_NUM					= 10;
+		const static int		MAX_SPIN_NUM						= 200;
+
+		// Member Functions ----------------------------------------------------
+		bool					lockSlow(const Deadline &inDeadline)
+		{
+			//	Spin up to twice the running average of the spins that paid
+			//	off; a lock that is held long lets the average decay
+			int		spinMax = mSpinNum.load(std::memory_order_relaxed) * 2 + INITIAL_SPIN_NUM;
+			if (spinMax > MAX_SPIN_NUM)
+				spinMax = MAX_SPIN_NUM;
+
+			int		spin;
+			for (spin = 0; spin < spinMax; spin++)
+			{
+				uint32_t	state = mState.load(std::memory_order_relaxed);
+				if (state == UNLOCKED &&
+					mState.compare_exchange_weak(state, LOCKED,
+							std::memory_order_acquire, std::memory_order_relaxed) != false)
+				{
+					updateSpinNum(spin);
+					return true;
+				}
+				if (state == CONTENDED)
+					break;
+				Futex::cpuRelax();
+			}
+			updateSpinNum(spin);
+
+			//	From here on the lock is taken as CONTENDED, since other
+			//	sleepers may still be queued behind us
+			while (mState.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED)
+			{
+				if (Futex::waitUntil(&mState, CONTENDED, inDeadline) == ETIMEDOUT ||
+					inDeadline.isExpired() != false)
+				{
+					if (mState.exchange(CONTENDED, std::memory_order_acquire) == UNLOCKED)
+						return true;
+					return false;
+				}
+			}
+			return true;
+		}
+		void					updateSpinNum(int inSpin)
+		{
+			int		spinNum = mSpinNum.load(std::memory_order_relaxed);
+			mSpinNum.store(spinNum + (inSpin - spinNum) / 8, std::memory_order_relaxed);
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<uint32_t>	mState;
+		std::atomic<int>		mSpinNum;
+	};
+}
+
+#endif // TBC_FUTEX_MUTEX_HPP
@@ -0,0 +1,721 @@
+// =============================================================================
+//  Future.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Future.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc future and promise
+
+	This file defines Future<T> and Promise<T>, a one-shot channel for
+	handing a result (or an exception) from one thread to another, with
+	continuations (then) and the whenAll/whenAny combinators.
+
+	Setting and reading a value is lock-free; the Event in the shared
+	state is only signaled when a thread actually blocked in wait().
+*/
+
+#ifndef TBC_FUTURE_HPP
+#define TBC_FUTURE_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stddef.h>
+#include <new>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#include "tbc/Event.hpp"
+#include "tbc/Function.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	template <class T>
+	class	Future;
+	template <class T>
+	class	Promise;
+	template <class T>
+	struct	WhenAnyResult;
+
+	// -------------------------------------------------------------------------
+	// FutureStateBase class
+	// -------------------------------------------------------------------------
+	//	Reference counted state shared by a Promise and its Future.
+	//	mCallbacks is a lock-free stack of callbacks; it is swapped with
+	//	READY_MARK when the state becomes ready, and callbacks added after
+	//	that run immediately on the adding thread.
+	class	FutureStateBase
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								FutureStateBase()
+									: mEvent(true)
+								{
+									mRefCount.store(1, std::memory_order_relaxed);
+									mCallbacks.store(NULL, std::memory_order_relaxed);
+									mHasWaiter.store(false, std::memory_order_relaxed);
+								}
+		virtual					~FutureStateBase()
+								{
+									CallbackNode	*node = mCallbacks.load(std::memory_order_relaxed);
+									while (node != NULL && node != getReadyMark())
+									{
+										CallbackNode	*next = node->mNext;
+										delete node;
+										node = next;
+									}
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					addRef()
+		{
+			mRefCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		void					release()
+		{
+			if (mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete this;
+		}
+		bool					isReady() const
+		{
+			return (mCallbacks.load(std::memory_order_acquire) == getReadyMark());
+		}
+		bool					hasException() const
+		{
+			return (bool )mException;
+		}
+		std::exception_ptr		getException() const
+		{
+			return mException;
+		}
+		bool					timedWait(timeout_t inMilliseconds)
+		{
+			if (isReady() != false)
+				return true;
+
+			//	Pairs with markReady(): either it sees the flag or we see ready
+			mHasWaiter.store(true, std::memory_order_seq_cst);
+			if (isReady() != false)
+				return true;
+
+			mEvent.timedWait(inMilliseconds);
+			return isReady();
+		}
+		//	The callback runs on the thread that makes the state ready, or on
+		//	the calling thread if the state is ready already
+		void					addCallback(Function<void ()> inCallback)
+		{
+			CallbackNode	*node = new CallbackNode(std::move(inCallback));
+			CallbackNode	*head = mCallbacks.load(std::memory_order_acquire);
+
+			do
+			{
+				if (head == getReadyMark())
+				{
+					node->mFunc();
+					delete node;
+					return;
+				}
+				node->mNext = head;
+			}
+			while (mCallbacks.compare_exchange_weak(head, node,
+						std::memory_order_acq_rel, std::memory_order_acquire) == false);
+		}
+		void					setException(std::exception_ptr inException)
+		{
+			mException = inException;
+			markReady();
+		}
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		void					markReady()
+		{
+			CallbackNode	*node = mCallbacks.exchange(getReadyMark(), std::memory_order_seq_cst);
+
+			if (mHasWaiter.load(std::memory_order_seq_cst) != false)
+				mEvent.signal();
+
+			//	Run the callbacks in the order they were added
+			CallbackNode	*ordered = NULL;
+			while (node != NULL)
+			{
+				CallbackNode	*next = node->mNext;
+				node->mNext = ordered;
+				ordered = node;
+				node = next;
+			}
+			while (ordered != NULL)
+			{
+				CallbackNode	*next = ordered->mNext;
+				ordered->mFunc();
+				delete ordered;
+				ordered = next;
+			}
+		}
+
+	private:
+		// ---------------------------------------------------------------------
+		// CallbackNode struct
+		// ---------------------------------------------------------------------
+		struct	CallbackNode
+		{
+								CallbackNode(Function<void ()> &&inFunc)
+									: mNext(NULL), mFunc(std::move(inFunc))
+								{
+								}
+
+			CallbackNode		*mNext;
+			Function<void ()>	mFunc;
+		};
+
+		// Static Functions ----------------------------------------------------
+		static CallbackNode		*getReadyMark()
+		{
+			return (CallbackNode *)1;
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<int>		mRefCount;
+		std::atomic<CallbackNode *>	mCallbacks;
+		std::atomic<bool>		mHasWaiter;
+		std::exception_ptr		mException;
+		Event					mEvent;
+	};
+
+	// -------------------------------------------------------------------------
+	// FutureState class
+	// -------------------------------------------------------------------------
+	template <class T>
+	class	FutureState : public FutureStateBase
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								FutureState()
+								{
+									mHasValue = false;
+								}
+		virtual					~FutureState()
+								{
+									if (mHasValue != false)
+										((T *)&mValue)->~T();
+								}
+
+		// Member Functions ----------------------------------------------------
+		template <class V>
+		void					setValue(V &&inValue)
+		{
+			new (&mValue) T(std::forward<V>(inValue));
+			mHasValue = true;
+			markReady();
+		}
+		//	The state must be ready. Rethrows a stored exception.
+		T						takeValue()
+		{
+			if (hasException() != false)
+				std::rethrow_exception(getException());
+			return std::move(*(T *)&mValue);
+		}
+
+	private:
+		// Member Variables ----------------------------------------------------
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type	mValue;
+		bool					mHasValue;
+	};
+
+	template <>
+	class	FutureState<void> : public FutureStateBase
+	{
+	public:
+		// Member Functions ----------------------------------------------------
+		void					setValue()
+		{
+			markReady();
+		}
+		void					takeValue()
+		{
+			if (hasException() != false)
+				std::rethrow_exception(getException());
+		}
+	};
+
+	// -------------------------------------------------------------------------
+	// FutureContinuation struct
+	// -------------------------------------------------------------------------
+	//	Feeds the value of a ready state to a then() callable and stores the
+	//	result; the void cases only differ in the call syntax
+	template <class T, class U>
+	struct	FutureContinuation
+	{
+		template <class F>
+		static void				run(F &inFunc, FutureState<T> *inSource, FutureState<U> *outResult)
+		{
+			outResult->setValue(inFunc(inSource->takeValue()));
+		}
+	};
+	template <class T>
+	struct	FutureContinuation<T, void>
+	{
+		template <class F>
+		static void				run(F &inFunc, FutureState<T> *inSource, FutureState<void> *outResult)
+		{
+			inFunc(inSource->takeValue());
+			outResult->setValue();
+		}
+	};
+	template <class U>
+	struct	FutureContinuation<void, U>
+	{
+		template <class F>
+		static void				run(F &inFunc, FutureState<void> *inSource, FutureState<U> *outResult)
+		{
+			inSource->takeValue();
+			outResult->setValue(inFunc());
+		}
+	};
+	template <>
+	struct	FutureContinuation<void, void>
+	{
+		template <class F>
+		static void				run(F &inFunc, FutureState<void> *inSource, FutureState<void> *outResult)
+		{
+			inSource->takeValue();
+			inFunc();
+			outResult->setValue();
+		}
+	};
+
+	template <class F, class T>
+	struct	FutureResult
+	{
+		typedef decltype(std::declval<F &>()(std::declval<T>()))	Type;
+	};
+	template <class F>
+	struct	FutureResult<F, void>
+	{
+		typedef decltype(std::declval<F &>()())	Type;
+	};
+
+	// -------------------------------------------------------------------------
+	// Future class
+	// -------------------------------------------------------------------------
+	template <class T>
+	class	Future
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Future()
+								{
+									mState = NULL;
+								}
+								Future(Future &&inFuture)
+								{
+									mState = inFuture.mState;
+									inFuture.mState = NULL;
+								}
+								~Future()
+								{
+									if (mState != NULL)
+										mState->release();
+								}
+
+		// Operators -----------------------------------------------------------
+		Future					&operator=(Future &&inFuture)
+		{
+			if (this == &inFuture)
+				return *this;
+
+			if (mState != NULL)
+				mState->release();
+			mState = inFuture.mState;
+			inFuture.mState = NULL;
+			return *this;
+		}
+
+		// Member Functions ----------------------------------------------------
+		//	A future is valid until get() or then() consumed it
+		bool					isValid() const
+		{
+			return (mState != NULL);
+		}
+		bool					isReady() const
+		{
+			checkValid();
+			return mState->isReady();
+		}
+		void					wait() const
+		{
+			timedWait(Thread::WAIT_INFINITE);
+		}
+		bool					timedWait(timeout_t inMilliseconds) const
+		{
+			checkValid();
+			return mState->timedWait(inMilliseconds);
+		}
+		//	Waits for the result and returns it. An exception set by the
+		//	promise (e.g. a tbc::Exception thrown in the producer thread) is
+		//	rethrown here. The future is consumed.
+		T						get()
+		{
+			wait();
+
+			TakeGuard	guard(mState);
+			mState = NULL;
+			return guard.mState->takeValue();
+		}
+		//	Runs inFunc with the value once it is ready and returns a future
+		//	for its result. inFunc runs on the thread that sets the value, or
+		//	immediately if the value is already there. If this future holds an
+		//	exception, inFunc is skipped and the exception is passed on.
+		//	The future is consumed.
+		template <class F>
+		Future<typename FutureResult<F, T>::Type>	then(F inFunc)
+		{
+			typedef typename FutureResult<F, T>::Type	U;
+
+			checkValid();
+
+			FutureState<T>	*source = mState;
+			FutureState<U>	*result = new FutureState<U>();
+			mState = NULL;
+			result->addRef();
+
+			source->addCallback(
+				[source, result, inFunc]() mutable
+				{
+					if (source->hasException() != false)
+						result->setException(source->getException());
+					else
+					{
+						try
+						{
+							FutureContinuation<T, U>::run(inFunc, source, result);
+						}
+
+						catch(...)
+						{
+							result->setException(std::current_exception());
+						}
+					}
+					source->release();
+					result->release();
+				});
+
+			return Future<U>(result);
+		}
+
+	private:
+		// ---------------------------------------------------------------------
+		// TakeGuard struct
+		// ---------------------------------------------------------------------
+		//	Releases the state once the value has been moved out
+		struct	TakeGuard
+		{
+								TakeGuard(FutureState<T> *inState)
+									: mState(inState)
+								{
+								}
+								~TakeGuard()
+								{
+									mState->release();
+								}
+
+			FutureState<T>		*mState;
+		};
+
+		// Constructors --------------------------------------------------------
+		explicit				Future(FutureState<T> *inState)
+								{
+									mState = inState;
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					checkValid() const
+		{
+			if (mState == NULL)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+						"Future is not valid", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		}
+
+		// Member Variables ----------------------------------------------------
+		FutureState<T>			*mState;
+
+		template <class V>
+		friend class			Future;
+		template <class V>
+		friend class			Promise;
+		template <class V>
+		friend Future<std::vector<Future<V> > >	whenAll(std::vector<Future<V> > &&inFutures);
+		template <class V>
+		friend Future<WhenAnyResult<V> >	whenAny(std::vector<Future<V> > &&inFutures);
+		template <class V>
+		friend class			WhenAnyContext;
+	};
+
+	// -------------------------------------------------------------------------
+	// Promise class
+	// -------------------------------------------------------------------------
+	template <class T>
+	class	Promise
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Promise()
+								{
+									mState = new FutureState<T>();
+									mIsSatisfied = false;
+									mIsFutureRetrieved = false;
+								}
+								Promise(Promise &&inPromise)
+								{
+									mState = inPromise.mState;
+									mIsSatisfied = inPromise.mIsSatisfied;
+									mIsFutureRetrieved = inPromise.mIsFutureRetrieved;
+									inPromise.mState = NULL;
+								}
+		//	A promise destroyed without a value breaks its future; get() then
+		//	throws SyncObjectException
+								~Promise()
+								{
+									abandon();
+								}
+
+		// Operators -----------------------------------------------------------
+		Promise					&operator=(Promise &&inPromise)
+		{
+			if (this == &inPromise)
+				return *this;
+
+			abandon();
+			mState = inPromise.mState;
+			mIsSatisfied = inPromise.mIsSatisfied;
+			mIsFutureRetrieved = inPromise.mIsFutureRetrieved;
+			inPromise.mState = NULL;
+			return *this;
+		}
+
+		// Member Functions ----------------------------------------------------
+		Future<T>				getFuture()
+		{
+			checkValid();
+			if (mIsFutureRetrieved != false)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+						"Future is already retrieved", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			mIsFutureRetrieved = true;
+			mState->addRef();
+			return Future<T>(mState);
+		}
+		template <class... V>
+		void					setValue(V&&... inValue)
+		{
+			checkSatisfiable();
+			//	If the value's constructor throws the promise stays
+			//	unsatisfied, so it can still be set or gets abandoned
+			mState->setValue(std::forward<V>(inValue)...);
+			mIsSatisfied = true;
+		}
+		void					setException(std::exception_ptr inException)
+		{
+			checkSatisfiable();
+			mState->setException(inException);
+			mIsSatisfied = true;
+		}
+		//	To be called from a catch block
+		void					setCurrentException()
+		{
+			setException(std::current_exception());
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		void					checkValid() const
+		{
+			if (mState == NULL)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+						"Promise is not valid", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		}
+		void					checkSatisfiable() const
+		{
+			checkValid();
+			if (mIsSatisfied != false)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+						"Promise is already satisfied", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		}
+		void					abandon()
+		{
+			if (mState == NULL)
+				return;
+
+			if (mIsSatisfied == false)
+			{
+				mState->setException(std::make_exception_ptr(
+						SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+							"Promise was destroyed without a value", TBC_EXCEPTION_LOCATION_MACRO)));
+			}
+			mState->release();
+			mState = NULL;
+		}
+
+		// Member Variables ----------------------------------------------------
+		FutureState<T>			*mState;
+		bool					mIsSatisfied;
+		bool					mIsFutureRetrieved;
+	};
+
+	// -------------------------------------------------------------------------
+	// WhenAnyResult struct
+	// -------------------------------------------------------------------------
+	template <class T>
+	struct	WhenAnyResult
+	{
+		size_t					mIndex;		// first ready future (NO_INDEX if none)
+		std::vector<Future<T> >	mFutures;
+
+		const static size_t		NO_INDEX							= (size_t )-1;
+	};
+
+	// -------------------------------------------------------------------------
+	// WhenAnyContext class
+	// -------------------------------------------------------------------------
+	//	Shared by the callbacks of whenAny(); deleted by the last one
+	template <class T>
+	class	WhenAnyContext
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								WhenAnyContext(std::vector<Future<T> > &&inFutures)
+									: mFutures(std::move(inFutures))
+								{
+									mRefCount.store((int )mFutures.size() + 1, std::memory_order_relaxed);
+									mIsDone.store(false, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		Future<WhenAnyResult<T> >	start()
+		{
+			Future<WhenAnyResult<T> >	future = mPromise.getFuture();
+			std::vector<FutureState<T> *>	states;
+
+			//	The futures may be handed out as soon as the first callback
+			//	runs, so keep the states alive while registering
+			for (size_t i = 0; i < mFutures.size(); i++)
+			{
+				states.push_back(mFutures[i].mState);
+				states[i]->addRef();
+			}
+			if (states.empty() != false)
+				complete(WhenAnyResult<T>::NO_INDEX);
+
+			for (size_t i = 0; i < states.size(); i++)
+			{
+				states[i]->addCallback(
+					[this, i]()
+					{
+						complete(i);
+						release();
+					});
+				states[i]->release();
+			}
+			release();
+			return future;
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		void					complete(size_t inIndex)
+		{
+			if (mIsDone.exchange(true, std::memory_order_acq_rel) != false)
+				return;
+
+			WhenAnyResult<T>	result;
+			result.mIndex = inIndex;
+			result.mFutures = std::move(mFutures);
+			mPromise.setValue(std::move(result));
+		}
+		void					release()
+		{
+			if (mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete this;
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::vector<Future<T> >	mFutures;
+		Promise<WhenAnyResult<T> >	mPromise;
+		std::atomic<int>		mRefCount;
+		std::atomic<bool>		mIsDone;
+	};
+
+	// Functions -------------------------------------------------------------------
+	//	Becomes ready when all inFutures are ready and returns them (each
+	//	holding its value or exception). Consumes inFutures.
+	template <class T>
+	Future<std::vector<Future<T> > >	whenAll(std::vector<Future<T> > &&inFutures)
+	{
+		struct	Context
+		{
+			std::vector<Future<T> >				mFutures;
+			Promise<std::vector<Future<T> > >	mPromise;
+			std::atomic<size_t>					mRemaining;
+
+			void				release()
+			{
+				if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					mPromise.setValue(std::move(mFutures));
+					delete this;
+				}
+			}
+		};
+
+		for (size_t i = 0; i < inFutures.size(); i++)
+			inFutures[i].checkValid();
+
+		Context	*context = new Context();
+		context->mFutures = std::move(inFutures);
+		context->mRemaining.store(context->mFutures.size() + 1, std::memory_order_relaxed);
+
+		Future<std::vector<Future<T> > >	future = context->mPromise.getFuture();
+		for (size_t i = 0; i < context->mFutures.size(); i++)
+			context->mFutures[i].mState->addCallback([context]() { context->release(); });
+		context->release();
+
+		return future;
+	}
+	//	Becomes ready as soon as one of inFutures is ready and returns its
+	//	index together with all the futures. Consumes inFutures.
+	template <class T>
+	Future<WhenAnyResult<T> >	whenAny(std::vector<Future<T> > &&inFutures)
+	{
+		for (size_t i = 0; i < inFutures.size(); i++)
+			inFutures[i].checkValid();
+
+		WhenAnyContext<T>	*context = new WhenAnyContext<T>(std::move(inFutures));
+		return context->start();
+	}
+}
+
+#endif // TBC_FUTURE_HPP
@@ -0,0 +1,350 @@
+// =============================================================================
+//  IpcRing.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/IpcRing.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc shared-memory ring buffer
+
+	This file defines a ring buffer of variable-length records in named
+	shared memory, for one producer process and one consumer process.
+	Records are written and read in place, so a frame is copied at most
+	once (by the producer, into the ring). The indices are lock-free; a
+	side only enters the kernel when the ring is full or empty.
+*/
+
+#ifndef TBC_IPC_RING_HPP
+#define TBC_IPC_RING_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#include "tbc/Futex.hpp"
+#include "tbc/Deadline.hpp"
+#include "tbc/SharedMemory.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// IpcRing class
+	// -------------------------------------------------------------------------
+	//	Both sides open the ring with the same name and capacity; whoever
+	//	comes first creates it. A record never wraps around the end of the
+	//	buffer: if it does not fit, the rest of the buffer is skipped. A
+	//	record larger than getMaxRecordSize() (about half the capacity) may
+	//	therefore have to wait until the ring is drained.
+	//
+	//		void	*frame = ring.beginWrite(frameSize);
+	//		capture(frame);
+	//		ring.commitWrite(frameSize);
+	//
+	//		size_t		size;
+	//		const void	*frame = ring.beginRead(&size);
+	//		process(frame, size);
+	//		ring.endRead();
+	//
+	//	Wake-ups use process-shared futexes on Linux; elsewhere a blocked
+	//	side polls. The name stays until remove() is called.
+	class	IpcRing
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								IpcRing(const char *inName, size_t inCapacity)
+								{
+									mCapacity = (inCapacity + RECORD_ALIGN - 1) & ~(size_t )(RECORD_ALIGN - 1);
+									mMemory.open(inName, sizeof(Control) + mCapacity);
+									mControl = (Control *)mMemory.getAddress();
+									mBuffer = (char *)mMemory.getAddress() + sizeof(Control);
+									mWriteSize = 0;
+									mReadSize = 0;
+
+									if (mMemory.isCreator() != false)
+										initControl();
+									else
+										waitForControl();
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Producer: reserves room for a record of inSize bytes and returns
+		//	where to write it, or NULL if inDeadline passed first
+		void					*beginWrite(size_t inSize, const Deadline &inDeadline = Deadline::infinite())
+		{
+			if (mWriteSize != 0)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"commitWrite() was not called", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			size_t	need = getRecordSize(inSize);
+			if (inSize > UINT32_MAX || need > mCapacity)
+			{
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"inSize is larger than the ring", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			for (;;)
+			{
+				uint64_t	write = mControl->mWriteIndex.load(std::memory_order_relaxed);
+				uint64_t	read = mControl->mReadIndex.load(std::memory_order_acquire);
+				size_t		free = mCapacity - (size_t )(write - read);
+				size_t		offset = (size_t )(write % mCapacity);
+				size_t		contiguous = mCapacity - offset;
+
+				if (need <= contiguous)
+				{
+					if (need <= free)
+					{
+						mWriteSize = need;
+						getRecord(offset)->mSize = (uint32_t )inSize;
+						return getRecord(offset) + 1;
+					}
+				}
+				else if (contiguous <= free)
+				{
+					//	Skip the tail of the buffer and retry from the start
+					getRecord(offset)->mSize = PADDING_MARK;
+					publishWrite(write + contiguous);
+					continue;
+				}
+
+				if (waitForChange(&mControl->mReadSequence, &mControl->mIsProducerWaiting,
+							&mControl->mReadIndex, read, inDeadline) == false)
+					return NULL;
+			}
+		}
+		//	Producer: publishes the record; inSize may be smaller than the
+		//	size passed to beginWrite()
+		void					commitWrite(size_t inSize)
+		{
+			if (mWriteSize == 0 || getRecordSize(inSize) > mWriteSize)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"commitWrite() does not match beginWrite()", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			uint64_t	write = mControl->mWriteIndex.load(std::memory_order_relaxed);
+			getRecord((size_t )(write % mCapacity))->mSize = (uint32_t )inSize;
+			mWriteSize = 0;
+			publishWrite(write + getRecordSize(inSize));
+		}
+		//	Producer: copies inData into a new record
+		bool					write(const void *inData, size_t inSize, const Deadline &inDeadline = Deadline::infinite())
+		{
+			void	*record = beginWrite(inSize, inDeadline);
+			if (record == NULL)
+				return false;
+			memcpy(record, inData, inSize);
+			commitWrite(inSize);
+			return true;
+		}
+		//	Consumer: returns the oldest record in place, or NULL if
+		//	inDeadline passed first. The record stays valid until endRead().
+		const void				*beginRead(size_t *outSize, const Deadline &inDeadline = Deadline::infinite())
+		{
+			if (mReadSize != 0)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"endRead() was not called", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			for (;;)
+			{
+				uint64_t	read = mControl->mReadIndex.load(std::memory_order_relaxed);
+				uint64_t	write = mControl->mWriteIndex.load(std::memory_order_acquire);
+
+				if (read != write)
+				{
+					size_t	offset = (size_t )(read % mCapacity);
+					Record	*record = getRecord(offset);
+
+					if (record->mSize == PADDING_MARK)
+					{
+						publishRead(read + (mCapacity - offset));
+						continue;
+					}
+					mReadSize = getRecordSize(record->mSize);
+					*outSize = record->mSize;
+					return record + 1;
+				}
+
+				if (waitForChange(&mControl->mWriteSequence, &mControl->mIsConsumerWaiting,
+							&mControl->mWriteIndex, write, inDeadline) == false)
+					return NULL;
+			}
+		}
+		//	Consumer: releases the record returned by beginRead()
+		void					endRead()
+		{
+			if (mReadSize == 0)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"beginRead() was not called", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			uint64_t	read = mControl->mReadIndex.load(std::memory_order_relaxed);
+			size_t		size = mReadSize;
+			mReadSize = 0;
+			publishRead(read + size);
+		}
+		//	Largest record that fits without draining the ring first
+		size_t					getMaxRecordSize() const
+		{
+			return (mCapacity / 2) - sizeof(Record);
+		}
+		size_t					getCapacity() const
+		{
+			return mCapacity;
+		}
+
+		// Static Functions ----------------------------------------------------
+		static void				remove(const char *inName)
+		{
+			SharedMemory::remove(inName);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		CACHE_LINE_SIZE						= 64;
+		const static size_t		RECORD_ALIGN						= 8;
+		const static uint32_t	PADDING_MARK						= 0xFFFFFFFF;
+		const static uint32_t	CONTROL_MAGIC						= 0x52435049;	//	"IPCR"
+		const static timeout_t	OPEN_TIMEOUT						= 1000;
+
+		// ---------------------------------------------------------------------
+		// Record class
+		// ---------------------------------------------------------------------
+		struct	Record
+		{
+			uint32_t			mSize;
+			uint32_t			mReserved;
+		};
+
+		// ---------------------------------------------------------------------
+		// Control class
+		// ---------------------------------------------------------------------
+		//	One cache line per direction: an index, the futex word its
+		//	publisher bumps, and the flag of the side waiting for it. The
+		//	waiting side writes the flag only when it is about to sleep, so
+		//	on the fast path each line is written by its publisher alone,
+		//	and the publisher finds the flag in the line it just wrote.
+		struct	Control
+		{
+			std::atomic<uint32_t>	mMagic;
+			uint64_t				mCapacity;
+
+			alignas(CACHE_LINE_SIZE) std::atomic<uint64_t>	mWriteIndex;
+			std::atomic<uint32_t>	mWriteSequence;
+			std::atomic<uint32_t>	mIsConsumerWaiting;
+
+			alignas(CACHE_LINE_SIZE) std::atomic<uint64_t>	mReadIndex;
+			std::atomic<uint32_t>	mReadSequence;
+			std::atomic<uint32_t>	mIsProducerWaiting;
+		};
+
+		// Member Functions ----------------------------------------------------
+		Record					*getRecord(size_t inOffset)
+		{
+			return (Record *)(mBuffer + inOffset);
+		}
+		void					initControl()
+		{
+			Control	*control = new (mMemory.getAddress()) Control();
+			control->mCapacity = mCapacity;
+			control->mWriteIndex.store(0, std::memory_order_relaxed);
+			control->mWriteSequence.store(0, std::memory_order_relaxed);
+			control->mIsConsumerWaiting.store(0, std::memory_order_relaxed);
+			control->mReadIndex.store(0, std::memory_order_relaxed);
+			control->mReadSequence.store(0, std::memory_order_relaxed);
+			control->mIsProducerWaiting.store(0, std::memory_order_relaxed);
+			control->mMagic.store(CONTROL_MAGIC, std::memory_order_release);
+		}
+		void					waitForControl()
+		{
+			for (timeout_t t = 0; mControl->mMagic.load(std::memory_order_acquire) != CONTROL_MAGIC; t++)
+			{
+				if (t >= OPEN_TIMEOUT)
+				{
+					throw SyncObjectException( SyncObjectException::ILLEGAL_OBJECT_STATE,
+									"IpcRing was never initialized", TBC_EXCEPTION_LOCATION_MACRO);
+				}
+				Thread::sleep(1);
+			}
+			if (mControl->mCapacity != mCapacity)
+			{
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"IpcRing capacity mismatch", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+		}
+		void					publishWrite(uint64_t inIndex)
+		{
+			mControl->mWriteIndex.store(inIndex, std::memory_order_seq_cst);
+			wakeOther(&mControl->mWriteSequence, &mControl->mIsConsumerWaiting);
+		}
+		void					publishRead(uint64_t inIndex)
+		{
+			mControl->mReadIndex.store(inIndex, std::memory_order_seq_cst);
+			wakeOther(&mControl->mReadSequence, &mControl->mIsProducerWaiting);
+		}
+		//	The waiting flag and the index are a Dekker pair: either the
+		//	publisher sees the flag and wakes us, or we see the new index
+		bool					waitForChange(std::atomic<uint32_t> *inSequence, std::atomic<uint32_t> *inIsWaiting,
+									std::atomic<uint64_t> *inIndex, uint64_t inSeen, const Deadline &inDeadline)
+		{
+			uint32_t	sequence = inSequence->load(std::memory_order_seq_cst);
+			inIsWaiting->store(1, std::memory_order_seq_cst);
+			if (inIndex->load(std::memory_order_seq_cst) == inSeen)
+			{
+				if (Futex::waitUntil(inSequence, sequence, inDeadline, true) == ETIMEDOUT)
+				{
+					inIsWaiting->store(0, std::memory_order_relaxed);
+					return (inIndex->load(std::memory_order_acquire) != inSeen);
+				}
+			}
+			inIsWaiting->store(0, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Static Functions ----------------------------------------------------
+		static void				wakeOther(std::atomic<uint32_t> *inSequence, std::atomic<uint32_t> *inIsWaiting)
+		{
+			if (inIsWaiting->load(std::memory_order_seq_cst) == 0)
+				return;
+			inSequence->fetch_add(1, std::memory_order_seq_cst);
+			Futex::wakeAll(inSequence, true);
+		}
+		static size_t			getRecordSize(size_t inSize)
+		{
+			return (sizeof(Record) + inSize + RECORD_ALIGN - 1) & ~(size_t )(RECORD_ALIGN - 1);
+		}
+
+		// Member Variables ----------------------------------------------------
+		SharedMemory			mMemory;
+		Control					*mControl;
+		char					*mBuffer;
+		size_t					mCapacity;
+		size_t					mWriteSize;
+		size_t					mReadSize;
+
+								IpcRing(const IpcRing &);
+		IpcRing					&operator=(const IpcRing &);
+	};
+}
+
+#endif // TBC_IPC_RING_HPP
@@ -0,0 +1,129 @@
+// =============================================================================
+//  Latch.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Latch.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc one-shot latch
+
+	This file defines a latch: a counter that threads count down and that
+	releases every waiter once it reaches zero. Unlike tbc::Barrier it is
+	used once, and the threads counting down need not wait themselves.
+*/
+
+#ifndef TBC_LATCH_HPP
+#define TBC_LATCH_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <errno.h>
+#include <atomic>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Futex.hpp"
+#include "tbc/Deadline.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Latch class
+	// -------------------------------------------------------------------------
+	//	The counter itself is the futex word; every count down changes it,
+	//	so a sleeping waiter may wake up early and just waits again.
+	class	Latch
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Latch(uint32_t inCount)
+								{
+									mCount.store(inCount, std::memory_order_relaxed);
+									mWaiterNum.store(0, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					countDown(uint32_t inNum = 1)
+		{
+			uint32_t	count = mCount.load(std::memory_order_relaxed);
+			do
+			{
+				if (inNum > count)
+				{
+					throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+									"Latch counted down below zero", TBC_EXCEPTION_LOCATION_MACRO);
+				}
+			}
+			while (mCount.compare_exchange_weak(count, count - inNum,
+						std::memory_order_seq_cst, std::memory_order_relaxed) == false);
+
+			if (count == inNum && mWaiterNum.load(std::memory_order_seq_cst) != 0)
+				Futex::wakeAll(&mCount);
+		}
+		bool					tryWait() const
+		{
+			return (mCount.load(std::memory_order_acquire) == 0);
+		}
+		void					wait()
+		{
+			waitUntil(Deadline::infinite());
+		}
+		//	Returns false if the count did not reach zero in time
+		bool					waitFor(uint64_t inNanoseconds)
+		{
+			return waitUntil(Deadline::fromNow(inNanoseconds));
+		}
+		bool					waitUntil(const Deadline &inDeadline)
+		{
+			for (int i = 0; i < SPIN_NUM; i++)
+			{
+				if (tryWait() != false)
+					return true;
+				Futex::cpuRelax();
+			}
+
+			mWaiterNum.fetch_add(1, std::memory_order_seq_cst);
+			uint32_t	count;
+			while ((count = mCount.load(std::memory_order_acquire)) != 0)
+			{
+				if (Futex::waitUntil(&mCount, count, inDeadline) == ETIMEDOUT ||
+					inDeadline.isExpired() != false)
+					break;
+			}
+			mWaiterNum.fetch_sub(1, std::memory_order_relaxed);
+			return tryWait();
+		}
+		void					arriveAndWait(uint32_t inNum = 1)
+		{
+			countDown(inNum);
+			wait();
+		}
+		uint32_t				getCount() const
+		{
+			return mCount.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static int		SPIN_NUM							= 1000;
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<uint32_t>	mCount;
+		std::atomic<uint32_t>	mWaiterNum;
+
+								Latch(const Latch &);
+		Latch					&operator=(const Latch &);
+	};
+}
+
+#endif // TBC_LATCH_HPP
@@ -0,0 +1,187 @@
+// =============================================================================
+//  MCSLock.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/MCSLock.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc MCS queue lock
+
+	This file defines the Mellor-Crummey and Scott queue lock. Waiters
+	form a linked queue and each spins on a flag in its own node, so a
+	release touches only the cache line of the next waiter. The lock is
+	FIFO fair and scales best of the spin locks under heavy contention.
+*/
+
+#ifndef TBC_MCS_LOCK_HPP
+#define TBC_MCS_LOCK_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stddef.h>
+#include <atomic>
+#include "tbc/Futex.hpp"
+#include "tbc/SyncObjectException.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// MCSLock class
+	// -------------------------------------------------------------------------
+	//	lock(Node &) and unlock(Node &) take a queue node owned by the caller,
+	//	which must stay alive and untouched until the matching unlock().
+	//	The node-less lock()/tryLock()/unlock() match tbc::Mutex; they take
+	//	nodes from a small per-thread pool, so one thread can hold at most
+	//	NODE_POOL_NUM of these locks at once.
+	class	MCSLock
+	{
+	public:
+		// ---------------------------------------------------------------------
+		// Node class
+		// ---------------------------------------------------------------------
+		struct alignas(64)	Node
+		{
+			std::atomic<Node *>	mNext;
+			std::atomic<bool>	mIsWaiting;
+		};
+
+		// Constructors and Destructor -----------------------------------------
+								MCSLock()
+								{
+									mTail.store(NULL, std::memory_order_relaxed);
+									mHolder = NULL;
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					lock(Node &ioNode)
+		{
+			ioNode.mNext.store(NULL, std::memory_order_relaxed);
+			ioNode.mIsWaiting.store(true, std::memory_order_relaxed);
+
+			Node	*prev = mTail.exchange(&ioNode, std::memory_order_acq_rel);
+			if (prev == NULL)
+				return;
+
+			prev->mNext.store(&ioNode, std::memory_order_release);
+			for (unsigned int spin = 0;
+				ioNode.mIsWaiting.load(std::memory_order_acquire) != false; spin++)
+			{
+				if (spin < YIELD_SPIN_NUM)
+					Futex::cpuRelax();
+				else
+					Futex::yield();
+			}
+		}
+		bool					tryLock(Node &ioNode)
+		{
+			ioNode.mNext.store(NULL, std::memory_order_relaxed);
+			ioNode.mIsWaiting.store(false, std::memory_order_relaxed);
+
+			Node	*tail = NULL;
+			return mTail.compare_exchange_strong(tail, &ioNode,
+						std::memory_order_acquire, std::memory_order_relaxed);
+		}
+		void					unlock(Node &ioNode)
+		{
+			Node	*next = ioNode.mNext.load(std::memory_order_acquire);
+			if (next == NULL)
+			{
+				Node	*tail = &ioNode;
+				if (mTail.compare_exchange_strong(tail, NULL,
+							std::memory_order_release, std::memory_order_relaxed) != false)
+					return;
+
+				//	A successor has swapped the tail but not linked itself yet
+				while ((next = ioNode.mNext.load(std::memory_order_acquire)) == NULL)
+					Futex::cpuRelax();
+			}
+			next->mIsWaiting.store(false, std::memory_order_release);
+		}
+		void					lock()
+		{
+			Node	*node = allocNode();
+			lock(*node);
+			mHolder = node;
+		}
+		bool					tryLock()
+		{
+			Node	*node = allocNode();
+			if (tryLock(*node) == false)
+			{
+				freeNode(node);
+				return false;
+			}
+			mHolder = node;
+			return true;
+		}
+		void					unlock()
+		{
+			Node	*node = mHolder;
+			if (node == NULL)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"MCSLock is not locked", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			mHolder = NULL;
+			unlock(*node);
+			freeNode(node);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	NODE_POOL_NUM					= 8;
+		const static unsigned int	YIELD_SPIN_NUM					= 1000;
+
+		// ---------------------------------------------------------------------
+		// NodePool class
+		// ---------------------------------------------------------------------
+		struct	NodePool
+		{
+			Node				mNodes[NODE_POOL_NUM];
+			unsigned int		mUsedMask;
+		};
+
+		// Static Functions ----------------------------------------------------
+		static NodePool			&getNodePool()
+		{
+			static thread_local NodePool	sPool;
+			return sPool;
+		}
+		static Node				*allocNode()
+		{
+			NodePool	&pool = getNodePool();
+			for (unsigned int i = 0; i < NODE_POOL_NUM; i++)
+			{
+				if ((pool.mUsedMask & (1U << i)) == 0)
+				{
+					pool.mUsedMask |= (1U << i);
+					return &pool.mNodes[i];
+				}
+			}
+			throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+							"Too many MCSLock held by one thread", TBC_EXCEPTION_LOCATION_MACRO);
+		}
+		static void				freeNode(Node *inNode)
+		{
+			NodePool	&pool = getNodePool();
+			pool.mUsedMask &= ~(1U << (unsigned int )(inNode - pool.mNodes));
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<Node *>		mTail;
+		Node					*mHolder;	//	Written and read by the holder only
+	};
+}
+
+#endif // TBC_MCS_LOCK_HPP
@@ -24,8 +24,16 @@
 #define TBC_MUTEX_H
 
 // Includes --------------------------------------------------------------------
-#include "tbc/SyncObjectException.h"
-#include "tbc/Thread.h"
+#include "tbc/SyncObjectException.hpp"
+#ifdef TBC_MUTEX_PROFILING
+ #include "tbc/MutexProfiler.hpp"
+#endif
+#if defined(_PTHREAD) && defined(__linux__)
+ #define TBC_MUTEX_HAS_ROBUST
+#endif
+
+//	Labels a mutex with a name and the file:line of the call
+#define TBC_MUTEX_PROFILE_LABEL(inMutex, inName)	(inMutex).setProfileLabel((inName), TBC_EXCEPTION_AT)
 
 
 // Namespace -------------------------------------------------------------------
@@ -37,6 +45,18 @@ namespace tbc
 	class	Mutex
 	{
 	public:
+		// Constatns -----------------------------------------------------------
+		//	Options for the pthread implementation. Win32 mutexes already
+		//	report an abandoned owner and are boosted by the scheduler, so
+		//	the options are ignored there.
+		enum MutexOption
+		{
+			OPTION_PRIO_INHERIT		= 0x01,	//	PTHREAD_PRIO_INHERIT
+			OPTION_PRIO_PROTECT		= 0x02,	//	PTHREAD_PRIO_PROTECT (ceiling)
+			OPTION_ROBUST			= 0x04,	//	PTHREAD_MUTEX_ROBUST (Linux); see lock()
+			OPTION_PROCESS_SHARED	= 0x08	//	PTHREAD_PROCESS_SHARED, see SharedObject
+		};
+
 		// Constructors and Destructor -----------------------------------------
 								Mutex()
 								{
@@ -46,6 +66,18 @@ namespace tbc
 									mMutexInitError = pthread_mutex_init(&mMutex, NULL);
 								#endif	// specific parts end ------------------
 								}
+								//	inOptions is a combination of MutexOption.
+								//	inPriorityCeiling is used with OPTION_PRIO_PROTECT;
+								//	0 selects the highest SCHED_FIFO priority. If the
+								//	options are not supported, lock() throws.
+								Mutex(unsigned int inOptions, int inPriorityCeiling = 0)
+								{
+								#ifdef _WIN32	//	Win32 specific -------------
+									mMutex = ::CreateMutex(NULL, false, NULL);
+								#elif _PTHREAD	//	pthread specific -----------
+									mMutexInitError = initMutex(inOptions, inPriorityCeiling);
+								#endif	// specific parts end ------------------
+								}
 		virtual					~Mutex()
 								{
 								#ifdef _WIN32	//	Win32 specific -------------
@@ -58,8 +90,57 @@ namespace tbc
 								}
 
 		// Member Functions ----------------------------------------------------
+		//	If the previous owner died holding the mutex (OPTION_ROBUST, or
+		//	any Win32 mutex), lock() and tryLock() throw WAIT_CANCELED with
+		//	the mutex held. Repair the protected state, then call unlock().
 		void					lock()
 		{
+		#ifdef TBC_MUTEX_PROFILING
+			if (tryLockNative() != false)
+			{
+				mProfile.notifyLocked(0);
+				return;
+			}
+			uint64_t	waitStart = MutexProfile::getWaitStart();
+			lockNative();
+			mProfile.notifyLocked(waitStart);
+		#else
+			lockNative();
+		#endif
+		}
+		bool					tryLock()
+		{
+		#ifdef TBC_MUTEX_PROFILING
+			if (tryLockNative() == false)
+				return false;
+			mProfile.notifyLocked(0);
+			return true;
+		#else
+			return tryLockNative();
+		#endif
+		}
+		void					unlock()
+		{
+		#ifdef TBC_MUTEX_PROFILING
+			mProfile.notifyUnlocking();
+		#endif
+			unlockNative();
+		}
+		//	Names the mutex in MutexProfiler reports. Both strings must
+		//	outlive the mutex. Does nothing unless TBC_MUTEX_PROFILING is
+		//	defined; see also TBC_MUTEX_PROFILE_LABEL. OPTION_PROCESS_SHARED
+		//	mutexes are never reported.
+		void					setProfileLabel(const char *inName, const char *inSite = NULL)
+		{
+		#ifdef TBC_MUTEX_PROFILING
+			mProfile.setLabel(inName, inSite);
+		#endif
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		void					lockNative()
+		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
 			if (mMutex == NULL)
 			{
@@ -90,6 +171,8 @@ namespace tbc
 			}
 
 			int error = pthread_mutex_lock(&mMutex);
+			if (error == EOWNERDEAD)
+				recoverOwnerDead();
 			if (error != 0)
 			{
 				throw SyncObjectException( Exception::OS_ERROR,
@@ -98,7 +181,7 @@ namespace tbc
 			return;
 		#endif	// specific parts end ------------------------------------------
 		}
-		bool					tryLock()
+		bool					tryLockNative()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
 			if (mMutex == NULL)
@@ -136,6 +219,9 @@ namespace tbc
 			if (error == 0)
 				return true;
 
+			if (error == EOWNERDEAD)
+				recoverOwnerDead();
+
 			if (error != EBUSY)
 			{
 				throw SyncObjectException( Exception::OS_ERROR,
@@ -145,7 +231,7 @@ namespace tbc
 			return false;
 		#endif	// specific parts end ------------------------------------------
 		}
-		void					unlock()
+		void					unlockNative()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
 			if (mMutex == NULL)
@@ -176,13 +262,84 @@ namespace tbc
 		#endif	// specific parts end ------------------------------------------
 		}
 
-	private:
+	#ifdef _PTHREAD
+		int						initMutex(unsigned int inOptions, int inPriorityCeiling)
+		{
+			pthread_mutexattr_t	attr;
+			int					error = pthread_mutexattr_init(&attr);
+			if (error != 0)
+				return error;
+
+			if ((inOptions & OPTION_PRIO_INHERIT) != 0 && (inOptions & OPTION_PRIO_PROTECT) != 0)
+				error = EINVAL;
+			else if ((inOptions & OPTION_PRIO_INHERIT) != 0)
+				error = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+			else if ((inOptions & OPTION_PRIO_PROTECT) != 0)
+			{
+				if (inPriorityCeiling == 0)
+					inPriorityCeiling = sched_get_priority_max(SCHED_FIFO);
+				error = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_PROTECT);
+				if (error == 0)
+					error = pthread_mutexattr_setprioceiling(&attr, inPriorityCeiling);
+			}
+
+			if (error == 0 && (inOptions & OPTION_ROBUST) != 0)
+			{
+			#ifdef TBC_MUTEX_HAS_ROBUST
+				error = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+			#else
+				error = ENOTSUP;
+			#endif
+			}
+
+			if (error == 0 && (inOptions & OPTION_PROCESS_SHARED) != 0)
+			{
+				error = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+			#ifdef TBC_MUTEX_PROFILING
+				//	Other processes cannot follow this process's registry
+				//	links, so a shared mutex is not profiled
+				mProfile.unregister();
+			#endif
+			}
+
+			if (error == 0)
+				error = pthread_mutex_init(&mMutex, &attr);
+			pthread_mutexattr_destroy(&attr);
+			return error;
+		}
+		//	The previous owner of a robust mutex died while holding it. As
+		//	with WAIT_ABANDONED on Win32, the caller now owns the mutex and
+		//	gets WAIT_CANCELED: it must repair the protected state and then
+		//	call unlock(). The mutex is marked consistent first, so it stays
+		//	usable after that unlock.
+		void					recoverOwnerDead()
+		{
+		#ifdef TBC_MUTEX_HAS_ROBUST
+			int	error = pthread_mutex_consistent(&mMutex);
+			if (error != 0)
+			{
+				//	Unlocking an inconsistent mutex makes it unrecoverable,
+				//	which the other waiters then see as ENOTRECOVERABLE
+				pthread_mutex_unlock(&mMutex);
+				throw SyncObjectException( Exception::OS_ERROR,
+						"pthread_mutex_consistent() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+		#endif
+			throw SyncObjectException( SyncObjectException::WAIT_CANCELED,
+							"error == EOWNERDEAD", TBC_EXCEPTION_LOCATION_MACRO);
+		}
+	#endif
+
+		// Member Variables ----------------------------------------------------
 	#ifdef _WIN32	//	Win32 specific -----------------------------------------
 		HANDLE					mMutex;
 	#elif _PTHREAD	//	pthread specific ---------------------------------------
 		pthread_mutex_t			mMutex;
 		int						mMutexInitError;
 	#endif			// specific parts end --------------------------------------
+	#ifdef TBC_MUTEX_PROFILING
+		MutexProfile			mProfile;
+	#endif
 };
 
 #endif	// #ifdef TBC_MUTEX_H
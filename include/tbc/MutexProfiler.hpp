@@ -0,0 +1,293 @@
+// =============================================================================
+//  MutexProfiler.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/MutexProfiler.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc mutex contention profiler
+
+	This file defines the per-mutex statistics kept by tbc::Mutex when the
+	library is built with TBC_MUTEX_PROFILING defined, and a registry of
+	all live mutexes that reports the most contended ones. Without the
+	macro tbc::Mutex does not include this file and carries no overhead.
+*/
+
+#ifndef TBC_MUTEX_PROFILER_HPP
+#define TBC_MUTEX_PROFILER_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "tbc/Clock.hpp"
+#include "tbc/FutexMutex.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	class	MutexProfiler;
+
+	// -------------------------------------------------------------------------
+	// MutexProfile class
+	// -------------------------------------------------------------------------
+	//	The counters are only written by the thread holding the mutex, so
+	//	they need no read-modify-write; they are atomics so the registry can
+	//	read them at any time. Times are in nanoseconds.
+	class	MutexProfile
+	{
+	public:
+		// ---------------------------------------------------------------------
+		// Snapshot class
+		// ---------------------------------------------------------------------
+		struct	Snapshot
+		{
+			const char			*mName;
+			const char			*mSite;
+			uint64_t			mLockNum;
+			uint64_t			mContendedNum;
+			uint64_t			mTotalWaitTime;
+			uint64_t			mMaxWaitTime;
+			uint64_t			mTotalHoldTime;
+			uint64_t			mMaxHoldTime;
+		};
+
+		// Constructors and Destructor -----------------------------------------
+								MutexProfile();
+								~MutexProfile();
+
+		// Member Functions ----------------------------------------------------
+		//	Takes the profile out of the registry for good. Used for mutexes
+		//	in shared memory: the registry links are only valid in the
+		//	process that wrote them.
+		void					unregister();
+
+		//	Both strings must outlive the mutex (string literals usually)
+		void					setLabel(const char *inName, const char *inSite)
+		{
+			mName.store(inName, std::memory_order_relaxed);
+			mSite.store(inSite, std::memory_order_relaxed);
+		}
+		//	Called by the new holder right after the mutex was taken.
+		//	inWaitStart is 0 if the lock was not contended.
+		void					notifyLocked(uint64_t inWaitStart)
+		{
+			if (mDepth++ != 0)
+				return;
+
+			mLockTime = Clock::getFastNanoseconds();
+			add(mLockNum, 1);
+			if (inWaitStart != 0)
+			{
+				uint64_t	waitTime = mLockTime - inWaitStart;
+				add(mContendedNum, 1);
+				add(mTotalWaitTime, waitTime);
+				updateMax(mMaxWaitTime, waitTime);
+			}
+		}
+		//	Called by the holder right before the mutex is released
+		void					notifyUnlocking()
+		{
+			if (mDepth == 0 || --mDepth != 0)
+				return;
+
+			uint64_t	holdTime = Clock::getFastNanoseconds() - mLockTime;
+			add(mTotalHoldTime, holdTime);
+			updateMax(mMaxHoldTime, holdTime);
+		}
+		void					getSnapshot(Snapshot *outSnapshot) const
+		{
+			outSnapshot->mName = mName.load(std::memory_order_relaxed);
+			outSnapshot->mSite = mSite.load(std::memory_order_relaxed);
+			outSnapshot->mLockNum = mLockNum.load(std::memory_order_relaxed);
+			outSnapshot->mContendedNum = mContendedNum.load(std::memory_order_relaxed);
+			outSnapshot->mTotalWaitTime = mTotalWaitTime.load(std::memory_order_relaxed);
+			outSnapshot->mMaxWaitTime = mMaxWaitTime.load(std::memory_order_relaxed);
+			outSnapshot->mTotalHoldTime = mTotalHoldTime.load(std::memory_order_relaxed);
+			outSnapshot->mMaxHoldTime = mMaxHoldTime.load(std::memory_order_relaxed);
+		}
+
+		// Static Functions ----------------------------------------------------
+		static uint64_t			getWaitStart()
+		{
+			return Clock::getFastNanoseconds();
+		}
+
+	private:
+		friend class			MutexProfiler;
+
+		// Static Functions ----------------------------------------------------
+		static void				add(std::atomic<uint64_t> &ioValue, uint64_t inDelta)
+		{
+			ioValue.store(ioValue.load(std::memory_order_relaxed) + inDelta, std::memory_order_relaxed);
+		}
+		static void				updateMax(std::atomic<uint64_t> &ioValue, uint64_t inValue)
+		{
+			if (inValue > ioValue.load(std::memory_order_relaxed))
+				ioValue.store(inValue, std::memory_order_relaxed);
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<const char *>	mName;
+		std::atomic<const char *>	mSite;
+		std::atomic<uint64_t>	mLockNum;
+		std::atomic<uint64_t>	mContendedNum;
+		std::atomic<uint64_t>	mTotalWaitTime;
+		std::atomic<uint64_t>	mMaxWaitTime;
+		std::atomic<uint64_t>	mTotalHoldTime;
+		std::atomic<uint64_t>	mMaxHoldTime;
+		uint64_t				mLockTime;
+		unsigned int			mDepth;		//	Win32 mutexes are recursive
+		bool					mIsRegistered;
+		MutexProfile			*mPrev;
+		MutexProfile			*mNext;
+	};
+
+	// -------------------------------------------------------------------------
+	// MutexProfiler class
+	// -------------------------------------------------------------------------
+	//	Registry of the profiles of all live mutexes. The registry lock is a
+	//	FutexMutex so that it is not profiled itself.
+	class	MutexProfiler
+	{
+	public:
+		// Static Functions ----------------------------------------------------
+		//	The inNum mutexes with the most contended acquisitions, ties
+		//	broken by total wait time
+		static std::vector<MutexProfile::Snapshot>	getTopContended(size_t inNum)
+		{
+			std::vector<MutexProfile::Snapshot>	list;
+
+			getRegistryMutex().lock();
+			for (MutexProfile *profile = getHead(); profile != NULL; profile = profile->mNext)
+			{
+				MutexProfile::Snapshot	snapshot;
+				profile->getSnapshot(&snapshot);
+				if (snapshot.mLockNum != 0)
+					list.push_back(snapshot);
+			}
+			getRegistryMutex().unlock();
+
+			std::sort(list.begin(), list.end(), isMoreContended);
+			if (list.size() > inNum)
+				list.resize(inNum);
+			return list;
+		}
+		static void				dump(FILE *inFile = stdout, size_t inNum = 10)
+		{
+			std::vector<MutexProfile::Snapshot>	list = getTopContended(inNum);
+
+			fprintf(inFile, "%-24s %-32s %10s %10s %12s %12s %12s %12s\n",
+				"name", "site", "locks", "contended", "wait(us)", "maxwait(us)", "hold(us)", "maxhold(us)");
+			for (size_t i = 0; i < list.size(); i++)
+			{
+				const MutexProfile::Snapshot	&s = list[i];
+				fprintf(inFile, "%-24s %-32s %10llu %10llu %12.1f %12.1f %12.1f %12.1f\n",
+					(s.mName != NULL) ? s.mName : "(unnamed)",
+					(s.mSite != NULL) ? s.mSite : "-",
+					(unsigned long long )s.mLockNum,
+					(unsigned long long )s.mContendedNum,
+					s.mTotalWaitTime / 1000.0, s.mMaxWaitTime / 1000.0,
+					s.mTotalHoldTime / 1000.0, s.mMaxHoldTime / 1000.0);
+			}
+		}
+		//	Clears the counters of all live mutexes. Mutexes held at the time
+		//	still report their current hold on unlock.
+		static void				reset()
+		{
+			getRegistryMutex().lock();
+			for (MutexProfile *profile = getHead(); profile != NULL; profile = profile->mNext)
+			{
+				profile->mLockNum.store(0, std::memory_order_relaxed);
+				profile->mContendedNum.store(0, std::memory_order_relaxed);
+				profile->mTotalWaitTime.store(0, std::memory_order_relaxed);
+				profile->mMaxWaitTime.store(0, std::memory_order_relaxed);
+				profile->mTotalHoldTime.store(0, std::memory_order_relaxed);
+				profile->mMaxHoldTime.store(0, std::memory_order_relaxed);
+			}
+			getRegistryMutex().unlock();
+		}
+
+	private:
+		friend class			MutexProfile;
+
+		// Static Functions ----------------------------------------------------
+		static bool				isMoreContended(const MutexProfile::Snapshot &inA,
+									const MutexProfile::Snapshot &inB)
+		{
+			if (inA.mContendedNum != inB.mContendedNum)
+				return (inA.mContendedNum > inB.mContendedNum);
+			return (inA.mTotalWaitTime > inB.mTotalWaitTime);
+		}
+		static FutexMutex		&getRegistryMutex()
+		{
+			static FutexMutex	sMutex;
+			return sMutex;
+		}
+		static MutexProfile		*&getHead()
+		{
+			static MutexProfile	*sHead = NULL;
+			return sHead;
+		}
+		static void				add(MutexProfile *inProfile)
+		{
+			getRegistryMutex().lock();
+			MutexProfile	*&head = getHead();
+			inProfile->mPrev = NULL;
+			inProfile->mNext = head;
+			if (head != NULL)
+				head->mPrev = inProfile;
+			head = inProfile;
+			getRegistryMutex().unlock();
+		}
+		static void				remove(MutexProfile *inProfile)
+		{
+			getRegistryMutex().lock();
+			if (inProfile->mPrev != NULL)
+				inProfile->mPrev->mNext = inProfile->mNext;
+			else
+				getHead() = inProfile->mNext;
+			if (inProfile->mNext != NULL)
+				inProfile->mNext->mPrev = inProfile->mPrev;
+			getRegistryMutex().unlock();
+		}
+	};
+
+	// -------------------------------------------------------------------------
+	// MutexProfile inline functions
+	// -------------------------------------------------------------------------
+	inline	MutexProfile::MutexProfile()
+		: mName(NULL), mSite(NULL), mLockNum(0), mContendedNum(0),
+		  mTotalWaitTime(0), mMaxWaitTime(0), mTotalHoldTime(0), mMaxHoldTime(0),
+		  mLockTime(0), mDepth(0), mIsRegistered(true), mPrev(NULL), mNext(NULL)
+	{
+		MutexProfiler::add(this);
+	}
+	inline	MutexProfile::~MutexProfile()
+	{
+		unregister();
+	}
+	inline	void	MutexProfile::unregister()
+	{
+		if (mIsRegistered == false)
+			return;
+		MutexProfiler::remove(this);
+		mIsRegistered = false;
+	}
+}
+
+#endif // TBC_MUTEX_PROFILER_HPP
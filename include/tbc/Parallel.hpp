@@ -0,0 +1,534 @@
+// =============================================================================
+//  Parallel.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Parallel.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc parallel algorithms
+
+	This file defines parallelFor, parallelReduce, parallelTransform,
+	parallelSort and parallelInvoke on top of tbc::ThreadPool.
+
+	A range is cut into chunks of grain elements. The chunk range is split
+	in halves recursively, and every split hands one half to the pool, so
+	idle workers steal large pieces first and uneven chunks even out. The
+	calling thread works on the range as well and runs pending pool tasks
+	while it waits, so the functions may be nested and called from tasks.
+	The first exception thrown by a body cancels the remaining chunks and
+	is rethrown to the caller.
+*/
+
+#ifndef TBC_PARALLEL_HPP
+#define TBC_PARALLEL_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include "tbc/ThreadPool.hpp"
+#include "tbc/Event.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	class	ParallelGroup;
+
+	// -------------------------------------------------------------------------
+	// ParallelTask class
+	// -------------------------------------------------------------------------
+	class	ParallelTask : public ThreadPool::Task
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								ParallelTask()
+								{
+									mGroup = NULL;
+								}
+		virtual					~ParallelTask()
+								{
+								}
+
+		// Member Functions ----------------------------------------------------
+		virtual void			run();
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		virtual void			execute() = 0;
+		//	Called after execute(); tasks allocated with new delete themselves
+		virtual void			release()
+		{
+		}
+
+		// Member Variables ----------------------------------------------------
+		ParallelGroup			*mGroup;
+
+		friend class			ParallelGroup;
+	};
+
+	// -------------------------------------------------------------------------
+	// ParallelGroup class
+	// -------------------------------------------------------------------------
+	//	Counts the tasks spawned for one parallel call. The owner holds one
+	//	count itself and gives it up in wait(), so the group cannot complete
+	//	while the owner is still spawning.
+	class	ParallelGroup
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								ParallelGroup(ThreadPool &inPool)
+									: mPool(inPool)
+								{
+									mPendingNum.store(1, std::memory_order_relaxed);
+									mIsDone.store(false, std::memory_order_relaxed);
+									mIsCanceled.store(false, std::memory_order_relaxed);
+									mHasException.store(false, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					spawn(ParallelTask *inTask)
+		{
+			inTask->mGroup = this;
+			mPendingNum.fetch_add(1, std::memory_order_relaxed);
+			try
+			{
+				mPool.submit(inTask);
+			}
+
+			catch (...)
+			{
+				mPendingNum.fetch_sub(1, std::memory_order_relaxed);
+				throw;
+			}
+		}
+		//	Waits for all spawned tasks and rethrows the first exception.
+		//	Must be called exactly once by the owner.
+		void					wait()
+		{
+			finish();
+			while (mIsDone.load(std::memory_order_acquire) == false)
+			{
+				//	The last task is between its decrement and mIsDone
+				if (mPendingNum.load(std::memory_order_acquire) == 0)
+					continue;
+
+				if (mPool.tryRunPendingTask() != false)
+					continue;
+				mDoneEvent.timedWait(HELP_POLL_INTERVAL);
+			}
+
+			if (mHasException.load(std::memory_order_acquire) != false)
+				std::rethrow_exception(mException);
+		}
+		void					cancel(std::exception_ptr inException)
+		{
+			if (mHasException.exchange(true, std::memory_order_acq_rel) == false)
+				mException = inException;
+			mIsCanceled.store(true, std::memory_order_release);
+		}
+		bool					isCanceled() const
+		{
+			return mIsCanceled.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static timeout_t	HELP_POLL_INTERVAL					= 1;
+
+		// Member Functions ----------------------------------------------------
+		//	The group may be destroyed as soon as mIsDone is set
+		void					finish()
+		{
+			if (mPendingNum.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			mDoneEvent.signal();
+			mIsDone.store(true, std::memory_order_release);
+		}
+
+		// Member Variables ----------------------------------------------------
+		ThreadPool				&mPool;
+		std::atomic<size_t>		mPendingNum;
+		std::atomic<bool>		mIsDone;
+		std::atomic<bool>		mIsCanceled;
+		std::atomic<bool>		mHasException;
+		std::exception_ptr		mException;
+		Event					mDoneEvent;
+
+		friend class			ParallelTask;
+	};
+
+	inline void					ParallelTask::run()
+	{
+		ParallelGroup	*group = mGroup;
+
+		if (group->isCanceled() == false)
+		{
+			try
+			{
+				execute();
+			}
+
+			catch (...)
+			{
+				group->cancel(std::current_exception());
+			}
+		}
+
+		release();
+		group->finish();
+	}
+
+	// -------------------------------------------------------------------------
+	// ParallelChunkTask class
+	// -------------------------------------------------------------------------
+	//	Runs inFunc(chunk) for every chunk in [inBegin, inEnd), handing the
+	//	upper half to the pool until a single chunk is left
+	template <class F>
+	class	ParallelChunkTask : public ParallelTask
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								ParallelChunkTask(F *inFunc, size_t inBegin, size_t inEnd)
+								{
+									mFunc = inFunc;
+									mBegin = inBegin;
+									mEnd = inEnd;
+								}
+
+		// Static Functions ----------------------------------------------------
+		static void				runChunks(ParallelGroup &inGroup, F &inFunc, size_t inBegin, size_t inEnd)
+		{
+			while (inEnd - inBegin > 1)
+			{
+				if (inGroup.isCanceled() != false)
+					return;
+
+				size_t				mid = inBegin + (inEnd - inBegin) / 2;
+				ParallelChunkTask	*task = new ParallelChunkTask(&inFunc, mid, inEnd);
+				try
+				{
+					inGroup.spawn(task);
+				}
+
+				catch (...)
+				{
+					delete task;
+					throw;
+				}
+				inEnd = mid;
+			}
+
+			if (inBegin < inEnd && inGroup.isCanceled() == false)
+				inFunc(inBegin);
+		}
+		static void				runAll(ThreadPool &inPool, F &inFunc, size_t inChunkNum)
+		{
+			ParallelGroup	group(inPool);
+
+			try
+			{
+				runChunks(group, inFunc, 0, inChunkNum);
+			}
+
+			catch (...)
+			{
+				group.cancel(std::current_exception());
+			}
+			group.wait();
+		}
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		virtual void			execute()
+		{
+			runChunks(*mGroup, *mFunc, mBegin, mEnd);
+		}
+		virtual void			release()
+		{
+			delete this;
+		}
+
+	private:
+		// Member Variables ----------------------------------------------------
+		F						*mFunc;
+		size_t					mBegin;
+		size_t					mEnd;
+	};
+
+	// -------------------------------------------------------------------------
+	// ParallelInvokeTask class
+	// -------------------------------------------------------------------------
+	template <class F>
+	class	ParallelInvokeTask : public ParallelTask
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								ParallelInvokeTask(F *inFunc)
+								{
+									mFunc = inFunc;
+								}
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		virtual void			execute()
+		{
+			(*mFunc)();
+		}
+
+	private:
+		// Member Variables ----------------------------------------------------
+		F						*mFunc;
+	};
+
+	// Functions -------------------------------------------------------------------
+	//	Grain used when the caller passes 0: about eight chunks per thread,
+	//	enough for stealing to balance uneven chunks
+	inline size_t				getParallelGrain(ThreadPool &inPool, size_t inNum, size_t inMinGrain = 1)
+	{
+		size_t	grain = inNum / ((size_t )(inPool.getThreadNum() + 1) * 8);
+		if (grain < inMinGrain)
+			grain = inMinGrain;
+		return grain;
+	}
+	//	Runs inFunc1 on the calling thread and inFunc2 on the pool, and
+	//	returns when both are done. The task lives on the caller's stack.
+	template <class F1, class F2>
+	void						parallelInvoke(ThreadPool &inPool, F1 inFunc1, F2 inFunc2)
+	{
+		ParallelGroup			group(inPool);
+		ParallelInvokeTask<F2>	task(&inFunc2);
+
+		try
+		{
+			group.spawn(&task);
+			inFunc1();
+		}
+
+		catch (...)
+		{
+			group.cancel(std::current_exception());
+		}
+		group.wait();
+	}
+	//	Calls inFunc(begin, end) for consecutive sub-ranges of at most
+	//	inGrain indices covering [inFirst, inLast)
+	template <class Index, class F>
+	void						parallelForRange(ThreadPool &inPool, Index inFirst, Index inLast,
+											F inFunc, size_t inGrain = 0)
+	{
+		if (inLast <= inFirst)
+			return;
+
+		size_t	num = (size_t )(inLast - inFirst);
+		if (inGrain == 0)
+			inGrain = getParallelGrain(inPool, num);
+
+		auto	chunk = [&](size_t inChunk)
+		{
+			Index	begin = inFirst + (Index )(inChunk * inGrain);
+			Index	end = (num - inChunk * inGrain > inGrain) ? begin + (Index )inGrain : inLast;
+			inFunc(begin, end);
+		};
+		ParallelChunkTask<decltype(chunk)>::runAll(inPool, chunk, (num + inGrain - 1) / inGrain);
+	}
+	//	Calls inFunc(i) for every i in [inFirst, inLast)
+	template <class Index, class F>
+	void						parallelFor(ThreadPool &inPool, Index inFirst, Index inLast,
+											F inFunc, size_t inGrain = 0)
+	{
+		parallelForRange(inPool, inFirst, inLast,
+			[&](Index inBegin, Index inEnd)
+			{
+				for (Index i = inBegin; i < inEnd; i++)
+					inFunc(i);
+			},
+			inGrain);
+	}
+	//	inFunc(begin, end, init) folds a sub-range into init and returns it;
+	//	inCombine(a, b) merges two partial results. The partial results are
+	//	combined in index order, so the result does not depend on timing.
+	template <class Index, class T, class F, class C>
+	T							parallelReduce(ThreadPool &inPool, Index inFirst, Index inLast,
+											T inIdentity, F inFunc, C inCombine, size_t inGrain = 0)
+	{
+		if (inLast <= inFirst)
+			return inIdentity;
+
+		size_t	num = (size_t )(inLast - inFirst);
+		if (inGrain == 0)
+			inGrain = getParallelGrain(inPool, num);
+
+		size_t			chunkNum = (num + inGrain - 1) / inGrain;
+		std::vector<T>	partials(chunkNum, inIdentity);
+
+		auto	chunk = [&](size_t inChunk)
+		{
+			Index	begin = inFirst + (Index )(inChunk * inGrain);
+			Index	end = (num - inChunk * inGrain > inGrain) ? begin + (Index )inGrain : inLast;
+			partials[inChunk] = inFunc(begin, end, inIdentity);
+		};
+		ParallelChunkTask<decltype(chunk)>::runAll(inPool, chunk, chunkNum);
+
+		T	result = inIdentity;
+		for (size_t i = 0; i < chunkNum; i++)
+			result = inCombine(result, partials[i]);
+		return result;
+	}
+	//	*(inOut + i) = inFunc(*(inFirst + i)); random access iterators only
+	template <class InIt, class OutIt, class F>
+	OutIt						parallelTransform(ThreadPool &inPool, InIt inFirst, InIt inLast,
+											OutIt inOut, F inFunc, size_t inGrain = 0)
+	{
+		size_t	num = (size_t )(inLast - inFirst);
+
+		parallelForRange(inPool, (size_t )0, num,
+			[&](size_t inBegin, size_t inEnd)
+			{
+				std::transform(inFirst + inBegin, inFirst + inEnd, inOut + inBegin, inFunc);
+			},
+			inGrain);
+		return inOut + num;
+	}
+
+	// -------------------------------------------------------------------------
+	// ParallelSort class
+	// -------------------------------------------------------------------------
+	//	Merge sort: sub-ranges of up to inGrain elements are sorted with
+	//	std::sort, and the merges are split at the median of the larger run
+	//	so they run in parallel as well. The sort is not stable.
+	template <class It, class Comp>
+	class	ParallelSort
+	{
+	public:
+		typedef typename std::iterator_traits<It>::value_type	Value;
+		typedef typename std::vector<Value>::iterator			BufIt;
+
+		// Static Functions ----------------------------------------------------
+		static void				sort(ThreadPool &inPool, It inFirst, It inLast, Comp &inComp, size_t inGrain)
+		{
+			size_t	num = (size_t )(inLast - inFirst);
+			if (num < 2)
+				return;
+			if (inGrain == 0)
+				inGrain = getParallelGrain(inPool, num, MIN_GRAIN);
+			if (inGrain < 2)
+				inGrain = 2;
+			if (num <= inGrain)
+			{
+				std::sort(inFirst, inLast, inComp);
+				return;
+			}
+
+			std::vector<Value>	buf(num);
+			sortRange(inPool, inFirst, inLast, buf.begin(), false, inComp, inGrain);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		MIN_GRAIN							= 2048;
+
+		// Static Functions ----------------------------------------------------
+		//	Sorts [inFirst, inLast); the result ends up in inBuf if inIsToBuf,
+		//	otherwise in place. Both halves go to the opposite buffer first.
+		static void				sortRange(ThreadPool &inPool, It inFirst, It inLast, BufIt inBuf,
+											bool inIsToBuf, Comp &inComp, size_t inGrain)
+		{
+			size_t	num = (size_t )(inLast - inFirst);
+			if (num <= inGrain)
+			{
+				std::sort(inFirst, inLast, inComp);
+				if (inIsToBuf != false)
+					std::move(inFirst, inLast, inBuf);
+				return;
+			}
+
+			size_t	half = num / 2;
+			parallelInvoke(inPool,
+				[&]() { sortRange(inPool, inFirst, inFirst + half, inBuf, !inIsToBuf, inComp, inGrain); },
+				[&]() { sortRange(inPool, inFirst + half, inLast, inBuf + half, !inIsToBuf, inComp, inGrain); });
+
+			if (inIsToBuf != false)
+				merge(inPool, inFirst, inFirst + half, inFirst + half, inLast, inBuf, inComp, inGrain);
+			else
+				merge(inPool, inBuf, inBuf + half, inBuf + half, inBuf + num, inFirst, inComp, inGrain);
+		}
+		//	Stable merge of two sorted runs; ties take the element of run a
+		template <class SrcIt, class DstIt>
+		static void				merge(ThreadPool &inPool, SrcIt inA, SrcIt inAEnd, SrcIt inB, SrcIt inBEnd,
+											DstIt inOut, Comp &inComp, size_t inGrain)
+		{
+			size_t	numA = (size_t )(inAEnd - inA);
+			size_t	numB = (size_t )(inBEnd - inB);
+
+			if (numA + numB <= inGrain)
+			{
+				std::merge(std::make_move_iterator(inA), std::make_move_iterator(inAEnd),
+							std::make_move_iterator(inB), std::make_move_iterator(inBEnd),
+							inOut, inComp);
+				return;
+			}
+
+			SrcIt	midA, midB;
+			if (numA >= numB)
+			{
+				midA = inA + numA / 2;
+				midB = std::lower_bound(inB, inBEnd, *midA, inComp);
+			}
+			else
+			{
+				midB = inB + numB / 2;
+				midA = std::upper_bound(inA, inAEnd, *midB, inComp);
+			}
+
+			//	A split that leaves one side empty would recurse on the same
+			//	runs forever (e.g. all of run b goes before the median of a)
+			size_t	numLow = (size_t )(midA - inA) + (size_t )(midB - inB);
+			if (numLow == 0 || numLow == numA + numB)
+			{
+				std::merge(std::make_move_iterator(inA), std::make_move_iterator(inAEnd),
+							std::make_move_iterator(inB), std::make_move_iterator(inBEnd),
+							inOut, inComp);
+				return;
+			}
+
+			DstIt	midOut = inOut + numLow;
+			parallelInvoke(inPool,
+				[&]() { merge(inPool, inA, midA, inB, midB, inOut, inComp, inGrain); },
+				[&]() { merge(inPool, midA, inAEnd, midB, inBEnd, midOut, inComp, inGrain); });
+		}
+	};
+
+	// Functions -------------------------------------------------------------------
+	//	Sorts [inFirst, inLast) with random access iterators. Uses a buffer of
+	//	the same size, so the elements must be default constructible.
+	template <class It, class Comp>
+	void						parallelSort(ThreadPool &inPool, It inFirst, It inLast,
+											Comp inComp, size_t inGrain = 0)
+	{
+		ParallelSort<It, Comp>::sort(inPool, inFirst, inLast, inComp, inGrain);
+	}
+	template <class It>
+	void						parallelSort(ThreadPool &inPool, It inFirst, It inLast)
+	{
+		parallelSort(inPool, inFirst, inLast,
+			std::less<typename std::iterator_traits<It>::value_type>());
+	}
+}
+
+#endif // TBC_PARALLEL_HPP
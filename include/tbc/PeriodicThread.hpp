@@ -0,0 +1,265 @@
+// =============================================================================
+//  PeriodicThread.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/PeriodicThread.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc periodic thread
+
+	This file defines a thread that calls cycle() at a fixed period for
+	control loops. Every wake-up is an absolute monotonic deadline (the
+	start time plus a whole number of periods), so the loop does not drift
+	however long each cycle takes, and the optional spin tail trades CPU
+	time for microsecond wake-up accuracy.
+*/
+
+#ifndef TBC_PERIODIC_THREAD_HPP
+#define TBC_PERIODIC_THREAD_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#include "tbc/Thread.hpp"
+#include "tbc/Clock.hpp"
+#include "tbc/Futex.hpp"
+#include "tbc/SeqLock.hpp"
+#ifdef _PTHREAD
+ #include <errno.h>
+ #include <time.h>
+#endif
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// PeriodicThread class
+	// -------------------------------------------------------------------------
+	//	Subclass and implement cycle(). The first cycle runs one period after
+	//	start(). A cycle that runs past the next deadline is an overrun: the
+	//	deadlines already passed are skipped (counted in mMissedNum) and the
+	//	loop continues on the original time grid instead of bunching up.
+	//
+	//	Lateness is how long after its deadline a cycle actually started;
+	//	its spread (max - min) is the wake-up jitter. With a spin time of S
+	//	the thread sleeps until S before each deadline and busy-waits the
+	//	rest, which keeps the lateness within a few microseconds at the cost
+	//	of S of CPU time per cycle.
+	class	PeriodicThread : public Thread
+	{
+	public:
+		// ---------------------------------------------------------------------
+		// CycleInfo class
+		// ---------------------------------------------------------------------
+		struct	CycleInfo
+		{
+			uint64_t			mIndex;			// 0 for the first cycle
+			uint64_t			mDeadline;		// Clock::getNanoseconds() time
+			uint64_t			mLateness;		// ns between mDeadline and the call
+			uint64_t			mMissedNum;		// Deadlines skipped after the previous cycle
+		};
+
+		// ---------------------------------------------------------------------
+		// Statistics class
+		// ---------------------------------------------------------------------
+		struct	Statistics
+		{
+			uint64_t			mCycleNum;
+			uint64_t			mOverrunNum;	// Cycles that ran past the next deadline
+			uint64_t			mMissedNum;		// Deadlines skipped because of overruns
+			uint64_t			mMinLateness;
+			uint64_t			mMaxLateness;
+			uint64_t			mTotalLateness;
+			uint64_t			mMaxCycleTime;	// Longest cycle() call
+		};
+
+		// Constructors and Destructor -----------------------------------------
+		//	inSpinNanoseconds is the busy-wait before each deadline; 0 sleeps
+		//	all the way
+								PeriodicThread(uint64_t inPeriodNanoseconds, uint64_t inSpinNanoseconds = 0)
+								{
+									if (inPeriodNanoseconds == 0)
+									{
+										throw ThreadException( Exception::PARAM_ERROR,
+												"inPeriodNanoseconds == 0", TBC_EXCEPTION_LOCATION_MACRO);
+									}
+									mPeriod = inPeriodNanoseconds;
+									mSpinTime = inSpinNanoseconds;
+									mIsStopRequested.store(false, std::memory_order_relaxed);
+									resetStatistics();
+								}
+		virtual					~PeriodicThread()
+								{
+									try
+									{
+										stop();
+									}
+
+									catch (...)
+									{
+									}
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	The period and spin time are read once at start()
+		void					start()
+		{
+			mIsStopRequested.store(false, std::memory_order_relaxed);
+			Thread::start();
+		}
+		//	Returns after the current cycle (and at most one period's sleep)
+		void					stop()
+		{
+			if (Thread::isAlive() == false)
+				return;
+			Thread::signalStop();
+			Thread::join();
+		}
+		void					setPeriod(uint64_t inPeriodNanoseconds, uint64_t inSpinNanoseconds = 0)
+		{
+			if (inPeriodNanoseconds == 0)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"inPeriodNanoseconds == 0", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			if (Thread::isAlive() != false)
+			{
+				throw ThreadException( Exception::INVALID_OPERATION_ERROR,
+						"PeriodicThread is running", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			mPeriod = inPeriodNanoseconds;
+			mSpinTime = inSpinNanoseconds;
+		}
+		uint64_t				getPeriod() const
+		{
+			return mPeriod;
+		}
+		uint64_t				getSpinTime() const
+		{
+			return mSpinTime;
+		}
+		//	Can be called from any thread while the loop runs
+		Statistics				getStatistics() const
+		{
+			return mStatistics.load();
+		}
+		void					resetStatistics()
+		{
+			Statistics	statistics = {};
+			statistics.mMinLateness = Clock::TIME_INFINITE;
+			mStatistics.store(statistics);
+		}
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		virtual void			cycle(const CycleInfo &inInfo) = 0;
+
+		virtual void			runner()
+		{
+			const uint64_t	period = mPeriod;
+			const uint64_t	spinTime = (mSpinTime < period) ? mSpinTime : period;
+			CycleInfo		info = {};
+
+			info.mDeadline = Clock::getNanoseconds() + period;
+			while (mIsStopRequested.load(std::memory_order_relaxed) == false)
+			{
+				sleepUntil(info.mDeadline, spinTime);
+				if (mIsStopRequested.load(std::memory_order_relaxed) != false)
+					break;
+
+				uint64_t	begin = Clock::getNanoseconds();
+				info.mLateness = (begin > info.mDeadline) ? begin - info.mDeadline : 0;
+				cycle(info);
+				uint64_t	end = Clock::getNanoseconds();
+
+				//	Stay on the grid: the next deadline is the first one
+				//	still in the future
+				uint64_t	next = info.mDeadline + period;
+				uint64_t	missedNum = 0;
+				if (end >= next)
+				{
+					missedNum = (end - next) / period + 1;
+					next += missedNum * period;
+				}
+				updateStatistics(info.mLateness, end - begin, missedNum);
+
+				info.mIndex++;
+				info.mDeadline = next;
+				info.mMissedNum = missedNum;
+			}
+		}
+		virtual void			stopper()
+		{
+			mIsStopRequested.store(true, std::memory_order_relaxed);
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		void					updateStatistics(uint64_t inLateness, uint64_t inCycleTime, uint64_t inMissedNum)
+		{
+			mStatistics.update([&](Statistics &ioStatistics)
+			{
+				ioStatistics.mCycleNum++;
+				if (inMissedNum != 0)
+				{
+					ioStatistics.mOverrunNum++;
+					ioStatistics.mMissedNum += inMissedNum;
+				}
+				if (inLateness < ioStatistics.mMinLateness)
+					ioStatistics.mMinLateness = inLateness;
+				if (inLateness > ioStatistics.mMaxLateness)
+					ioStatistics.mMaxLateness = inLateness;
+				ioStatistics.mTotalLateness += inLateness;
+				if (inCycleTime > ioStatistics.mMaxCycleTime)
+					ioStatistics.mMaxCycleTime = inCycleTime;
+			});
+		}
+
+		// Static Functions ----------------------------------------------------
+		//	Sleeps until inSpinTime before inDeadline, then spins the rest
+		static void				sleepUntil(uint64_t inDeadline, uint64_t inSpinTime)
+		{
+			uint64_t	wakeTime = inDeadline - inSpinTime;
+			if (Clock::getNanoseconds() < wakeTime)
+			{
+			#ifdef _WIN32	//	Win32 specific ---------------------------------
+				//	No absolute sleep; Sleep() rounds the remainder down and
+				//	the loop below spins the rest
+				const uint64_t	unit = Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT;
+				uint64_t		remaining = wakeTime - Clock::getNanoseconds();
+				if (remaining >= unit)
+					::Sleep((DWORD )(remaining / unit));
+			#elif _PTHREAD	//	pthread specific -------------------------------
+				struct timespec	time;
+				Clock::toTimespec(wakeTime, &time);
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR)
+					;
+			#endif	// specific parts end --------------------------------------
+			}
+			while (Clock::getNanoseconds() < inDeadline)
+				Futex::cpuRelax();
+		}
+
+		// Member Variables ----------------------------------------------------
+		uint64_t				mPeriod;
+		uint64_t				mSpinTime;
+		std::atomic<bool>		mIsStopRequested;
+		SeqLock<Statistics>		mStatistics;
+
+								PeriodicThread(const PeriodicThread &);
+		PeriodicThread			&operator=(const PeriodicThread &);
+	};
+}
+
+#endif // TBC_PERIODIC_THREAD_HPP
@@ -0,0 +1,282 @@
+// =============================================================================
+//  Reactor.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Reactor.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc epoll reactor
+
+	This file defines a small epoll reactor (Linux only): one thread
+	blocks on file descriptors and tbc::Event objects together and calls
+	a callback for each one that becomes ready, so no bridging threads
+	are needed between Events and I/O.
+*/
+
+#ifndef TBC_REACTOR_HPP
+#define TBC_REACTOR_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <errno.h>
+#include <map>
+#include <vector>
+#include <atomic>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#include "tbc/Event.hpp"
+#include "tbc/Function.hpp"
+#include <unistd.h>
+#include <sys/epoll.h>
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Reactor class
+	// -------------------------------------------------------------------------
+	//	add/modify/remove and the run functions must be called from one
+	//	thread (usually from inside the callbacks); only stop() may be
+	//	called from any thread. An event callback runs once per signal()
+	//	after the event was taken with timedWait(0), so an auto-reset event
+	//	is reset when its callback runs. Registered objects must outlive
+	//	their registration.
+	class	Reactor
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Reactor()
+									: mStopEvent(false)
+								{
+									mEpoll = epoll_create1(EPOLL_CLOEXEC);
+									if (mEpoll < 0)
+									{
+										throw SyncObjectException( Exception::OS_ERROR,
+												"epoll_create1() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+									}
+									mIsStopRequested.store(false, std::memory_order_relaxed);
+									mIsDispatching = false;
+									try
+									{
+										addEvent(mStopEvent, Function<void ()>(StopHandler()));
+									}
+
+									catch (...)
+									{
+										::close(mEpoll);
+										throw;
+									}
+								}
+								~Reactor()
+								{
+									for (std::map<int, Entry *>::iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+										delete it->second;
+									freeRemovedEntries();
+									::close(mEpoll);
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	inEvents is a mask of EPOLLIN, EPOLLOUT, EPOLLET and so on;
+		//	the callback gets the ready mask
+		void					addHandle(int inHandle, uint32_t inEvents, Function<void (uint32_t)> inCallback)
+		{
+			Entry	*entry = new Entry(inHandle, NULL);
+			entry->mHandleCallback = std::move(inCallback);
+			addEntry(entry, inEvents);
+		}
+		void					modifyHandle(int inHandle, uint32_t inEvents)
+		{
+			Entry	*entry = findEntry(inHandle);
+			control(EPOLL_CTL_MOD, inHandle, inEvents, entry);
+		}
+		void					removeHandle(int inHandle)
+		{
+			removeEntry(findEntry(inHandle));
+		}
+		void					addEvent(Event &inEvent, Function<void ()> inCallback)
+		{
+			Entry	*entry = new Entry(inEvent.getPollHandle(), &inEvent);
+			entry->mEventCallback = std::move(inCallback);
+			addEntry(entry, EPOLLIN);
+		}
+		void					removeEvent(Event &inEvent)
+		{
+			removeEntry(findEntry(inEvent.getPollHandle()));
+		}
+		//	Waits up to inMilliseconds and dispatches what is ready. Returns
+		//	the number of callbacks called.
+		int						runOnce(timeout_t inMilliseconds = Thread::WAIT_INFINITE)
+		{
+			struct epoll_event	events[MAX_EVENT_NUM];
+			int					timeout = (inMilliseconds == Thread::WAIT_INFINITE) ? -1 : (int )inMilliseconds;
+
+			int	num = epoll_wait(mEpoll, events, MAX_EVENT_NUM, timeout);
+			if (num < 0)
+			{
+				if (errno == EINTR)
+					return 0;
+				throw SyncObjectException( Exception::OS_ERROR,
+						"epoll_wait() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+			}
+
+			//	Callbacks may remove entries; those are freed after the batch
+			int	called = 0;
+			mIsDispatching = true;
+			try
+			{
+				for (int i = 0; i < num; i++)
+				{
+					if (dispatch((Entry *)events[i].data.ptr, events[i].events) != false)
+						called++;
+				}
+			}
+			catch (...)
+			{
+				mIsDispatching = false;
+				freeRemovedEntries();
+				throw;
+			}
+			mIsDispatching = false;
+			freeRemovedEntries();
+			return called;
+		}
+		//	Dispatches until stop() is called
+		void					run()
+		{
+			while (mIsStopRequested.exchange(false, std::memory_order_acquire) == false)
+				runOnce();
+		}
+		void					stop()
+		{
+			mIsStopRequested.store(true, std::memory_order_release);
+			mStopEvent.signal();
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static int		MAX_EVENT_NUM						= 64;
+
+		// ---------------------------------------------------------------------
+		// Entry class
+		// ---------------------------------------------------------------------
+		struct	Entry
+		{
+			int							mHandle;
+			Event						*mEvent;
+			bool						mIsRemoved;
+			Function<void (uint32_t)>	mHandleCallback;
+			Function<void ()>			mEventCallback;
+
+								Entry(int inHandle, Event *inEvent)
+									: mHandle(inHandle), mEvent(inEvent), mIsRemoved(false) {}
+		};
+
+		// ---------------------------------------------------------------------
+		// StopHandler class
+		// ---------------------------------------------------------------------
+		//	run() checks the stop flag itself; the event only wakes epoll_wait()
+		struct	StopHandler
+		{
+			void				operator()() {}
+		};
+
+		// Member Functions ----------------------------------------------------
+		void					addEntry(Entry *inEntry, uint32_t inEvents)
+		{
+			if (mEntries.find(inEntry->mHandle) != mEntries.end())
+			{
+				delete inEntry;
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"Handle is already registered", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			try
+			{
+				control(EPOLL_CTL_ADD, inEntry->mHandle, inEvents, inEntry);
+			}
+			catch (...)
+			{
+				delete inEntry;
+				throw;
+			}
+			mEntries[inEntry->mHandle] = inEntry;
+		}
+		Entry					*findEntry(int inHandle)
+		{
+			std::map<int, Entry *>::iterator	it = mEntries.find(inHandle);
+			if (it == mEntries.end())
+			{
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"Handle is not registered", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			return it->second;
+		}
+		void					removeEntry(Entry *inEntry)
+		{
+			epoll_ctl(mEpoll, EPOLL_CTL_DEL, inEntry->mHandle, NULL);
+			mEntries.erase(inEntry->mHandle);
+			inEntry->mIsRemoved = true;
+			if (mIsDispatching != false)
+				mRemovedEntries.push_back(inEntry);
+			else
+				delete inEntry;
+		}
+		void					freeRemovedEntries()
+		{
+			for (size_t i = 0; i < mRemovedEntries.size(); i++)
+				delete mRemovedEntries[i];
+			mRemovedEntries.clear();
+		}
+		void					control(int inOp, int inHandle, uint32_t inEvents, Entry *inEntry)
+		{
+			struct epoll_event	event;
+			event.events = inEvents;
+			event.data.ptr = inEntry;
+			if (epoll_ctl(mEpoll, inOp, inHandle, &event) != 0)
+			{
+				throw SyncObjectException( Exception::OS_ERROR,
+						"epoll_ctl() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+			}
+		}
+		bool					dispatch(Entry *inEntry, uint32_t inEvents)
+		{
+			if (inEntry->mIsRemoved != false)
+				return false;
+
+			if (inEntry->mEvent == NULL)
+			{
+				inEntry->mHandleCallback(inEvents);
+				return true;
+			}
+
+			inEntry->mEvent->clearPollHandle();
+			if (inEntry->mEvent->timedWait(0) == false)
+				return false;
+			inEntry->mEventCallback();
+			return true;
+		}
+
+		// Member Variables ----------------------------------------------------
+		int						mEpoll;
+		Event					mStopEvent;
+		std::atomic<bool>		mIsStopRequested;
+		bool					mIsDispatching;
+		std::map<int, Entry *>	mEntries;
+		std::vector<Entry *>	mRemovedEntries;
+
+								Reactor(const Reactor &);
+		Reactor					&operator=(const Reactor &);
+	};
+}
+
+#endif // TBC_REACTOR_HPP
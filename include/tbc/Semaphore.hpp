@@ -0,0 +1,147 @@
+// =============================================================================
+//  Semaphore.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Semaphore.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc counting semaphore
+
+	This file defines a counting semaphore on a futex word. Taking an
+	available permit is one compare-and-swap and returning permits is one
+	atomic add; the kernel is only involved when a thread has to wait for
+	a permit, or when release() finds sleeping waiters.
+*/
+
+#ifndef TBC_SEMAPHORE_HPP
+#define TBC_SEMAPHORE_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#include "tbc/Futex.hpp"
+#include "tbc/Deadline.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Semaphore class
+	// -------------------------------------------------------------------------
+	//	mCount is the number of free permits and also the futex word the
+	//	waiters sleep on while it is 0. mWaiterNum lets release() skip the
+	//	wake-up system call when nobody sleeps.
+	class	Semaphore
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Semaphore(uint32_t inCount = 0)
+								{
+									mCount.store(inCount, std::memory_order_relaxed);
+									mWaiterNum.store(0, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					acquire()
+		{
+			if (tryAcquire() != false)
+				return;
+			acquireSlow(Deadline::infinite());
+		}
+		bool					tryAcquire()
+		{
+			uint32_t	count = mCount.load(std::memory_order_relaxed);
+			while (count != 0)
+			{
+				if (mCount.compare_exchange_weak(count, count - 1,
+							std::memory_order_acquire, std::memory_order_relaxed) != false)
+					return true;
+			}
+			return false;
+		}
+		//	Returns false if no permit became free within inNanoseconds
+		bool					acquireFor(uint64_t inNanoseconds)
+		{
+			if (tryAcquire() != false)
+				return true;
+			return acquireSlow(Deadline::fromNow(inNanoseconds));
+		}
+		bool					acquireUntil(const Deadline &inDeadline)
+		{
+			if (tryAcquire() != false)
+				return true;
+			return acquireSlow(inDeadline);
+		}
+		//	Returns inNum permits at once and wakes up to inNum waiters
+		void					release(uint32_t inNum = 1)
+		{
+			if (inNum == 0)
+				return;
+
+			mCount.fetch_add(inNum, std::memory_order_seq_cst);
+			if (mWaiterNum.load(std::memory_order_seq_cst) != 0)
+				Futex::wake(&mCount, inNum);
+		}
+		//	A snapshot; other threads may change it at once
+		uint32_t				getCount() const
+		{
+			return mCount.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static int		SPIN_NUM							= 100;
+
+		// Member Functions ----------------------------------------------------
+		bool					acquireSlow(const Deadline &inDeadline)
+		{
+			for (int i = 0; i < SPIN_NUM; i++)
+			{
+				Futex::cpuRelax();
+				if (mCount.load(std::memory_order_relaxed) != 0 && tryAcquire() != false)
+					return true;
+			}
+
+			//	Pairs with release(): either it sees us counted, or the
+			//	futex wait sees a non-zero count and returns at once
+			mWaiterNum.fetch_add(1, std::memory_order_seq_cst);
+			bool	result;
+			for (;;)
+			{
+				if (tryAcquire() != false)
+				{
+					result = true;
+					break;
+				}
+				if (Futex::waitUntil(&mCount, 0, inDeadline) == ETIMEDOUT ||
+					inDeadline.isExpired() != false)
+				{
+					result = tryAcquire();
+					break;
+				}
+			}
+			mWaiterNum.fetch_sub(1, std::memory_order_relaxed);
+			return result;
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<uint32_t>	mCount;
+		std::atomic<uint32_t>	mWaiterNum;
+
+								Semaphore(const Semaphore &);
+		Semaphore				&operator=(const Semaphore &);
+	};
+}
+
+#endif // TBC_SEMAPHORE_HPP
@@ -0,0 +1,155 @@
+// =============================================================================
+//  SeqLock.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/SeqLock.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc sequence lock
+
+	This file defines a sequence lock holding a small value that is read
+	often and written rarely. Readers never write shared memory: they read
+	a sequence number, copy the value and retry if a writer got in between.
+*/
+
+#ifndef TBC_SEQ_LOCK_HPP
+#define TBC_SEQ_LOCK_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include "tbc/Futex.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// SeqLock class
+	// -------------------------------------------------------------------------
+	//	T must be trivially copyable and should be a few words at most. The
+	//	value is kept in relaxed atomic words, so a torn copy is detected by
+	//	the sequence check instead of being a data race. An odd sequence
+	//	means a write is in progress; writers take the odd value with a CAS,
+	//	so several writers are serialised without a separate mutex.
+	template <class T>
+	class	SeqLock
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+	public:
+		// Constructors and Destructor -----------------------------------------
+								SeqLock(const T &inValue = T())
+								{
+									mSequence.store(0, std::memory_order_relaxed);
+									writeWords(inValue);
+								}
+
+		// Member Functions ----------------------------------------------------
+		T						load() const
+		{
+			T	value;
+			while (tryLoad(&value) == false)
+				Futex::cpuRelax();
+			return value;
+		}
+		//	One attempt; returns false if a writer was active
+		bool					tryLoad(T *outValue) const
+		{
+			uint32_t	sequence = mSequence.load(std::memory_order_acquire);
+			if ((sequence & 1) != 0)
+				return false;
+
+			uintptr_t	words[WORD_NUM];
+			for (size_t i = 0; i < WORD_NUM; i++)
+				words[i] = mWords[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (mSequence.load(std::memory_order_relaxed) != sequence)
+				return false;
+
+			memcpy(outValue, words, sizeof(T));
+			return true;
+		}
+		void					store(const T &inValue)
+		{
+			uint32_t	sequence = beginWrite();
+			writeWords(inValue);
+			mSequence.store(sequence + 2, std::memory_order_release);
+		}
+		//	Read-modify-write under the writer lock: inFunc(T &)
+		template <class F>
+		void					update(F inFunc)
+		{
+			uint32_t	sequence = beginWrite();
+			T			value = readWords();
+			inFunc(value);
+			writeWords(value);
+			mSequence.store(sequence + 2, std::memory_order_release);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		WORD_NUM							= (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+		// Member Functions ----------------------------------------------------
+		uint32_t				beginWrite()
+		{
+			uint32_t	sequence = mSequence.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				if ((sequence & 1) != 0)
+				{
+					Futex::cpuRelax();
+					sequence = mSequence.load(std::memory_order_relaxed);
+					continue;
+				}
+				if (mSequence.compare_exchange_weak(sequence, sequence + 1,
+							std::memory_order_acquire, std::memory_order_relaxed) != false)
+					break;
+			}
+			//	Keeps the value stores after the odd sequence
+			std::atomic_thread_fence(std::memory_order_release);
+			return sequence;
+		}
+		T						readWords() const
+		{
+			uintptr_t	words[WORD_NUM];
+			T			value;
+
+			for (size_t i = 0; i < WORD_NUM; i++)
+				words[i] = mWords[i].load(std::memory_order_relaxed);
+			memcpy(&value, words, sizeof(T));
+			return value;
+		}
+		void					writeWords(const T &inValue)
+		{
+			uintptr_t	words[WORD_NUM] = {};
+
+			memcpy(words, &inValue, sizeof(T));
+			for (size_t i = 0; i < WORD_NUM; i++)
+				mWords[i].store(words[i], std::memory_order_relaxed);
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<uint32_t>	mSequence;
+		std::atomic<uintptr_t>	mWords[WORD_NUM];
+
+								SeqLock(const SeqLock &);
+		SeqLock					&operator=(const SeqLock &);
+	};
+}
+
+#endif // TBC_SEQ_LOCK_HPP
@@ -0,0 +1,391 @@
+// =============================================================================
+//  SharedMemory.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/SharedMemory.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for tbc named shared memory
+
+	This file defines SharedMemory, a named memory segment that several
+	processes can map (POSIX shm_open() or a Win32 file mapping), and
+	SharedObject, which constructs one object in such a segment and lets
+	other processes open it by name. Together with
+	Mutex::OPTION_PROCESS_SHARED and Event(manual, true) this gives
+	cross-process locking and signaling without pipes.
+*/
+
+#ifndef TBC_SHARED_MEMORY_HPP
+#define TBC_SHARED_MEMORY_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <string>
+#include <atomic>
+#include <utility>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+//	none
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// SharedMemory class
+	// -------------------------------------------------------------------------
+	//	Names follow shm_open(): a leading '/' and no other slashes. The
+	//	first process to open a name creates the segment, zero filled. On
+	//	pthread systems the name stays until remove() is called; on Win32
+	//	the segment goes away with its last handle.
+	class	SharedMemory
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								SharedMemory()
+								{
+									mAddress = NULL;
+									mSize = 0;
+									mIsCreator = false;
+								#ifdef _WIN32	//	Win32 specific -------------
+									mMapping = NULL;
+								#endif	// specific parts end ------------------
+								}
+								~SharedMemory()
+								{
+									close();
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Opens the segment, creating it with inSize bytes if it does not
+		//	exist. Returns true if this call created it.
+		bool					open(const char *inName, size_t inSize)
+		{
+			if (mAddress != NULL)
+			{
+				throw SyncObjectException( Exception::INVALID_OPERATION_ERROR,
+								"SharedMemory is already open", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			if (inName == NULL || inSize == 0)
+			{
+				throw SyncObjectException( Exception::PARAM_ERROR,
+								"inName == NULL || inSize == 0", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			mMapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+							(DWORD )((uint64_t )inSize >> 32), (DWORD )inSize, inName);
+			if (mMapping == NULL)
+			{
+				throw SyncObjectException( Exception::OS_ERROR,
+						"::CreateFileMappingA() failed", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
+			}
+			mIsCreator = (::GetLastError() != ERROR_ALREADY_EXISTS);
+
+			mAddress = ::MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, inSize);
+			if (mAddress == NULL)
+			{
+				DWORD	error = ::GetLastError();
+				::CloseHandle(mMapping);
+				mMapping = NULL;
+				throw SyncObjectException( Exception::OS_ERROR,
+						"::MapViewOfFile() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			int		fd;
+			for (;;)
+			{
+				fd = shm_open(inName, O_RDWR | O_CREAT | O_EXCL, 0600);
+				if (fd >= 0)
+				{
+					mIsCreator = true;
+					if (ftruncate(fd, (off_t )inSize) != 0)
+					{
+						int	error = errno;
+						::close(fd);
+						shm_unlink(inName);
+						throw SyncObjectException( Exception::OS_ERROR,
+								"ftruncate() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					}
+					break;
+				}
+				if (errno != EEXIST)
+				{
+					throw SyncObjectException( Exception::OS_ERROR,
+							"shm_open() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+				}
+
+				fd = shm_open(inName, O_RDWR, 0);
+				if (fd >= 0)
+				{
+					mIsCreator = false;
+					break;
+				}
+				//	Removed in between; try to create it again
+				if (errno != ENOENT)
+				{
+					throw SyncObjectException( Exception::OS_ERROR,
+							"shm_open() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+				}
+			}
+
+			//	The creator may not have sized the segment yet
+			if (mIsCreator == false && waitForSize(fd, inSize) == false)
+			{
+				::close(fd);
+				throw SyncObjectException( Exception::OS_ERROR,
+						"Shared memory segment is smaller than requested", TBC_EXCEPTION_LOCATION_MACRO, EINVAL);
+			}
+
+			void	*address = mmap(NULL, inSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			int		error = errno;
+			::close(fd);
+			if (address == MAP_FAILED)
+			{
+				if (mIsCreator != false)
+					shm_unlink(inName);
+				throw SyncObjectException( Exception::OS_ERROR,
+						"mmap() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+			mAddress = address;
+		#endif	// specific parts end ------------------------------------------
+
+			mName = inName;
+			mSize = inSize;
+			return mIsCreator;
+		}
+		void					close()
+		{
+			if (mAddress == NULL)
+				return;
+
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::UnmapViewOfFile(mAddress);
+			::CloseHandle(mMapping);
+			mMapping = NULL;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			munmap(mAddress, mSize);
+		#endif	// specific parts end ------------------------------------------
+			mAddress = NULL;
+			mSize = 0;
+			mIsCreator = false;
+		}
+		bool					isOpen() const
+		{
+			return (mAddress != NULL);
+		}
+		bool					isCreator() const
+		{
+			return mIsCreator;
+		}
+		void					*getAddress() const
+		{
+			return mAddress;
+		}
+		size_t					getSize() const
+		{
+			return mSize;
+		}
+		const char				*getName() const
+		{
+			return mName.c_str();
+		}
+
+		// Static Functions ----------------------------------------------------
+		//	Removes the name; processes that have the segment open keep it
+		static void				remove(const char *inName)
+		{
+		#ifdef _PTHREAD
+			shm_unlink(inName);
+		#endif
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static timeout_t	OPEN_TIMEOUT						= 1000;
+
+		// Static Functions ----------------------------------------------------
+	#ifdef _PTHREAD
+		static bool				waitForSize(int inFd, size_t inSize)
+		{
+			for (timeout_t t = 0; t < OPEN_TIMEOUT; t++)
+			{
+				struct stat	st;
+				if (fstat(inFd, &st) != 0)
+					return false;
+				if ((size_t )st.st_size >= inSize)
+					return true;
+				Thread::sleep(1);
+			}
+			return false;
+		}
+	#endif
+
+		// Member Variables ----------------------------------------------------
+		void					*mAddress;
+		size_t					mSize;
+		bool					mIsCreator;
+		std::string				mName;
+	#ifdef _WIN32	//	Win32 specific -----------------------------------------
+		HANDLE					mMapping;
+	#endif			// specific parts end --------------------------------------
+	};
+
+	// -------------------------------------------------------------------------
+	// SharedObject class
+	// -------------------------------------------------------------------------
+	//	Opens the object of type T named inName. The first process creates
+	//	it from the constructor arguments; the others wait until it is
+	//	constructed and get the same object, whatever arguments they pass.
+	//	The last SharedObject to go away destroys the object and removes the
+	//	name. A process that dies keeps its reference, so the name then has
+	//	to be removed with SharedMemory::remove().
+	//
+	//		SharedObject<Mutex>	lock("/capture-lock",
+	//								Mutex::OPTION_PROCESS_SHARED | Mutex::OPTION_ROBUST);
+	//		SharedObject<Event>	ready("/frame-ready", false, true);
+	//
+	//	T must not hold process-local resources: Win32 Mutex and Event own
+	//	handles, so on Win32 use named kernel objects instead.
+	template <class T>
+	class	SharedObject
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+		template <class... Args>
+								SharedObject(const char *inName, Args&&... inArgs)
+								{
+									for (;;)
+									{
+										if (mMemory.open(inName, OBJECT_OFFSET + sizeof(T)) != false)
+										{
+											create(std::forward<Args>(inArgs)...);
+											return;
+										}
+										if (attach() != false)
+											return;
+										mMemory.close();
+										Thread::sleep(1);
+									}
+								}
+								~SharedObject()
+								{
+									if (getHeader()->mRefNum.fetch_sub(1, std::memory_order_acq_rel) == 1)
+									{
+										//	Non-virtual call: the vtable of the creating
+										//	process may not be mapped here
+										get()->T::~T();
+										SharedMemory::remove(mMemory.getName());
+									}
+								}
+
+		// Member Functions ----------------------------------------------------
+		T						*get() const
+		{
+			return (T *)((char *)mMemory.getAddress() + OBJECT_OFFSET);
+		}
+		T						*operator->() const
+		{
+			return get();
+		}
+		T						&operator*() const
+		{
+			return *get();
+		}
+		bool					isCreator() const
+		{
+			return mMemory.isCreator();
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		OBJECT_OFFSET						= 64;
+		const static uint32_t	STATE_EMPTY							= 0;
+		const static uint32_t	STATE_READY							= 1;
+		const static timeout_t	OPEN_TIMEOUT						= 1000;
+
+		// ---------------------------------------------------------------------
+		// Header class
+		// ---------------------------------------------------------------------
+		struct	Header
+		{
+			std::atomic<uint32_t>	mState;
+			std::atomic<uint32_t>	mRefNum;
+		};
+		static_assert(alignof(T) <= OBJECT_OFFSET, "T is over-aligned for SharedObject");
+
+		// Member Functions ----------------------------------------------------
+		Header					*getHeader() const
+		{
+			return (Header *)mMemory.getAddress();
+		}
+		template <class... Args>
+		void					create(Args&&... inArgs)
+		{
+			Header	*header = getHeader();
+			try
+			{
+				new (get()) T(std::forward<Args>(inArgs)...);
+			}
+			catch (...)
+			{
+				SharedMemory::remove(mMemory.getName());
+				mMemory.close();
+				throw;
+			}
+			header->mRefNum.store(1, std::memory_order_relaxed);
+			header->mState.store(STATE_READY, std::memory_order_release);
+		}
+		//	Returns false if the object is being destroyed by its last user
+		bool					attach()
+		{
+			Header	*header = getHeader();
+			for (timeout_t t = 0; header->mState.load(std::memory_order_acquire) != STATE_READY; t++)
+			{
+				if (t >= OPEN_TIMEOUT)
+				{
+					throw SyncObjectException( SyncObjectException::ILLEGAL_OBJECT_STATE,
+							"Shared object was never constructed", TBC_EXCEPTION_LOCATION_MACRO);
+				}
+				Thread::sleep(1);
+			}
+
+			uint32_t	refNum = header->mRefNum.load(std::memory_order_relaxed);
+			while (refNum != 0)
+			{
+				if (header->mRefNum.compare_exchange_weak(refNum, refNum + 1,
+							std::memory_order_acq_rel, std::memory_order_relaxed) != false)
+					return true;
+			}
+			return false;
+		}
+
+		// Member Variables ----------------------------------------------------
+		SharedMemory			mMemory;
+
+								SharedObject(const SharedObject &);
+		SharedObject			&operator=(const SharedObject &);
+	};
+}
+
+#endif // TBC_SHARED_MEMORY_HPP
@@ -0,0 +1,249 @@
+// =============================================================================
+//  SharedMutex.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/SharedMutex.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc reader-writer mutex
+
+	This file defines a reader-writer mutex for read-mostly data. Readers
+	count themselves in one of READER_SLOT_NUM counters, each on its own
+	cache line, picked per thread, so concurrent readers on different
+	cores do not bounce a shared counter. Writers are preferred: once a
+	writer waits, new readers hold back until it is done.
+*/
+
+#ifndef TBC_SHARED_MUTEX_HPP
+#define TBC_SHARED_MUTEX_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <atomic>
+#include "tbc/Futex.hpp"
+#include "tbc/FutexMutex.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// SharedMutex class
+	// -------------------------------------------------------------------------
+	//	A shared lock must be released by the thread that took it. Neither
+	//	mode is recursive. The object is about 1 KB because of the padded
+	//	reader slots.
+	class	SharedMutex
+	{
+	public:
+		// ---------------------------------------------------------------------
+		// SharedGuard class
+		// ---------------------------------------------------------------------
+		class	SharedGuard
+		{
+		public:
+									SharedGuard(SharedMutex &inMutex)
+										: mMutex(inMutex)
+									{
+										mMutex.lockShared();
+									}
+									~SharedGuard()
+									{
+										mMutex.unlockShared();
+									}
+
+		private:
+									SharedGuard(const SharedGuard &);
+			SharedGuard				&operator=(const SharedGuard &);
+
+			SharedMutex				&mMutex;
+		};
+
+		// ---------------------------------------------------------------------
+		// ExclusiveGuard class
+		// ---------------------------------------------------------------------
+		class	ExclusiveGuard
+		{
+		public:
+									ExclusiveGuard(SharedMutex &inMutex)
+										: mMutex(inMutex)
+									{
+										mMutex.lock();
+									}
+									~ExclusiveGuard()
+									{
+										mMutex.unlock();
+									}
+
+		private:
+									ExclusiveGuard(const ExclusiveGuard &);
+			ExclusiveGuard			&operator=(const ExclusiveGuard &);
+
+			SharedMutex				&mMutex;
+		};
+
+		// Constructors and Destructor -----------------------------------------
+								SharedMutex()
+								{
+									for (unsigned int i = 0; i < READER_SLOT_NUM; i++)
+										new (getSlot(i)) std::atomic<int>(0);
+									mWriterState.store(NO_WRITER, std::memory_order_relaxed);
+									mDrainSequence.store(0, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					lockShared()
+		{
+			std::atomic<int>	*slot = getSlot(getThreadSlotIndex());
+
+			for (;;)
+			{
+				//	Pairs with lock(): either the writer sees our count, or we
+				//	see its state and back off
+				slot->fetch_add(1, std::memory_order_seq_cst);
+				if (mWriterState.load(std::memory_order_seq_cst) == NO_WRITER)
+					return;
+
+				releaseSlot(slot);
+				waitForWriter();
+			}
+		}
+		bool					tryLockShared()
+		{
+			std::atomic<int>	*slot = getSlot(getThreadSlotIndex());
+
+			slot->fetch_add(1, std::memory_order_seq_cst);
+			if (mWriterState.load(std::memory_order_seq_cst) == NO_WRITER)
+				return true;
+
+			releaseSlot(slot);
+			return false;
+		}
+		void					unlockShared()
+		{
+			releaseSlot(getSlot(getThreadSlotIndex()));
+		}
+		void					lock()
+		{
+			mWriterMutex.lock();
+			mWriterState.store(WRITER, std::memory_order_seq_cst);
+			waitForReaders();
+		}
+		bool					tryLock()
+		{
+			if (mWriterMutex.tryLock() == false)
+				return false;
+
+			mWriterState.store(WRITER, std::memory_order_seq_cst);
+			if (getReaderNum() == 0)
+				return true;
+
+			unlockWriter();
+			return false;
+		}
+		void					unlock()
+		{
+			unlockWriter();
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	READER_SLOT_NUM					= 16;
+		const static size_t		CACHE_LINE_SIZE						= 64;
+		const static uint32_t	NO_WRITER							= 0;
+		const static uint32_t	WRITER								= 1;
+		const static uint32_t	WRITER_WITH_WAITERS					= 2;
+		const static int		DRAIN_SPIN_NUM						= 100;
+
+		// Member Functions ----------------------------------------------------
+		std::atomic<int>		*getSlot(unsigned int inIndex)
+		{
+			uintptr_t	base = ((uintptr_t )mSlotBuffer + CACHE_LINE_SIZE - 1) & ~(uintptr_t )(CACHE_LINE_SIZE - 1);
+			return (std::atomic<int> *)(base + inIndex * CACHE_LINE_SIZE);
+		}
+		int						getReaderNum()
+		{
+			int		num = 0;
+			for (unsigned int i = 0; i < READER_SLOT_NUM; i++)
+				num += getSlot(i)->load(std::memory_order_seq_cst);
+			return num;
+		}
+		void					releaseSlot(std::atomic<int> *inSlot)
+		{
+			inSlot->fetch_sub(1, std::memory_order_seq_cst);
+			if (mWriterState.load(std::memory_order_seq_cst) != NO_WRITER)
+			{
+				mDrainSequence.fetch_add(1, std::memory_order_seq_cst);
+				Futex::wakeOne(&mDrainSequence);
+			}
+		}
+		void					waitForWriter()
+		{
+			uint32_t	state = mWriterState.load(std::memory_order_relaxed);
+			while (state != NO_WRITER)
+			{
+				if (state == WRITER &&
+					mWriterState.compare_exchange_weak(state, WRITER_WITH_WAITERS,
+							std::memory_order_relaxed) == false)
+					continue;
+
+				Futex::wait(&mWriterState, WRITER_WITH_WAITERS);
+				state = mWriterState.load(std::memory_order_relaxed);
+			}
+		}
+		void					waitForReaders()
+		{
+			for (int spin = 0; ; spin++)
+			{
+				//	Read the sequence first, so a release after the count
+				//	check makes the futex wait return at once
+				uint32_t	sequence = mDrainSequence.load(std::memory_order_seq_cst);
+				if (getReaderNum() == 0)
+					return;
+
+				if (spin < DRAIN_SPIN_NUM)
+					Futex::cpuRelax();
+				else
+					Futex::wait(&mDrainSequence, sequence);
+			}
+		}
+		void					unlockWriter()
+		{
+			if (mWriterState.exchange(NO_WRITER, std::memory_order_seq_cst) == WRITER_WITH_WAITERS)
+				Futex::wakeAll(&mWriterState);
+			mWriterMutex.unlock();
+		}
+
+		// Static Functions ----------------------------------------------------
+		//	Threads are spread over the slots round robin on first use
+		static unsigned int		getThreadSlotIndex()
+		{
+			static std::atomic<unsigned int>	sNextIndex(0);
+			static thread_local int				sIndex = -1;
+
+			if (sIndex < 0)
+				sIndex = (int )(sNextIndex.fetch_add(1, std::memory_order_relaxed) % READER_SLOT_NUM);
+			return (unsigned int )sIndex;
+		}
+
+		// Member Variables ----------------------------------------------------
+		char					mSlotBuffer[(READER_SLOT_NUM + 1) * CACHE_LINE_SIZE];
+		std::atomic<uint32_t>	mWriterState;
+		std::atomic<uint32_t>	mDrainSequence;
+		FutexMutex				mWriterMutex;
+	};
+}
+
+#endif // TBC_SHARED_MUTEX_HPP
@@ -0,0 +1,95 @@
+// =============================================================================
+//  SpinLock.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/SpinLock.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc spin lock
+
+	This file defines a test-and-test-and-set spin lock with exponential
+	backoff, for critical sections shorter than a system call. It has the
+	lock()/tryLock()/unlock() interface of tbc::Mutex. See also
+	tbc::TicketLock (fair) and tbc::MCSLock (queue, local spinning).
+*/
+
+#ifndef TBC_SPIN_LOCK_HPP
+#define TBC_SPIN_LOCK_HPP
+
+// Includes --------------------------------------------------------------------
+#include <atomic>
+#include "tbc/Futex.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// SpinLock class
+	// -------------------------------------------------------------------------
+	//	Waiters only read the flag while it is taken, so they spin in their
+	//	own cache; the backoff doubles up to MAX_BACKOFF pauses, after which
+	//	the waiter also yields its time slice. Not fair, not recursive.
+	class	SpinLock
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								SpinLock()
+								{
+									mIsLocked.store(false, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					lock()
+		{
+			if (mIsLocked.exchange(true, std::memory_order_acquire) == false)
+				return;
+
+			unsigned int	backoff = 1;
+			for (;;)
+			{
+				while (mIsLocked.load(std::memory_order_relaxed) != false)
+				{
+					for (unsigned int i = 0; i < backoff; i++)
+						Futex::cpuRelax();
+
+					if (backoff < MAX_BACKOFF)
+						backoff <<= 1;
+					else
+						Futex::yield();
+				}
+				if (mIsLocked.exchange(true, std::memory_order_acquire) == false)
+					return;
+			}
+		}
+		bool					tryLock()
+		{
+			if (mIsLocked.load(std::memory_order_relaxed) != false)
+				return false;
+			return (mIsLocked.exchange(true, std::memory_order_acquire) == false);
+		}
+		void					unlock()
+		{
+			mIsLocked.store(false, std::memory_order_release);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static unsigned int	MAX_BACKOFF						= 1024;
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<bool>		mIsLocked;
+	};
+}
+
+#endif // TBC_SPIN_LOCK_HPP
@@ -0,0 +1,358 @@
+// =============================================================================
+//  SpscRing.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/SpscRing.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc single-producer single-consumer ring
+
+	This file defines SpscRing, a lock-free bounded queue between exactly
+	one producer thread and one consumer thread, and BlockingSpscRing,
+	which adds waiting on tbc::Event when the ring is empty or full. Each
+	side keeps its index and a cached copy of the other side's index on
+	its own cache line, so in the common case a push or pop touches no
+	cache line written by the other thread except the slot itself.
+*/
+
+#ifndef TBC_SPSC_RING_HPP
+#define TBC_SPSC_RING_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+#include <atomic>
+#include <utility>
+#include "tbc/SyncObjectException.hpp"
+#include "tbc/Thread.hpp"
+#include "tbc/Event.hpp"
+#include "tbc/Deadline.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// SpscRing class
+	// -------------------------------------------------------------------------
+	//	try/bulk push functions may only be called from the producer thread
+	//	and pop functions only from the consumer thread. The capacity is
+	//	rounded up to a power of two. Indices run freely and are masked, so
+	//	every slot is usable.
+	template <class T>
+	class	SpscRing
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								SpscRing(size_t inCapacity)
+								{
+									if (inCapacity == 0 || inCapacity > MAX_CAPACITY)
+									{
+										throw SyncObjectException( Exception::PARAM_ERROR,
+														"inCapacity is out of range", TBC_EXCEPTION_LOCATION_MACRO);
+									}
+									size_t	capacity = 1;
+									while (capacity < inCapacity)
+										capacity <<= 1;
+
+									mCapacity = capacity;
+									mMask = capacity - 1;
+									mBuffer = (T *)::operator new(capacity * sizeof(T));
+									mWriteIndex.store(0, std::memory_order_relaxed);
+									mCachedReadIndex = 0;
+									mReadIndex.store(0, std::memory_order_relaxed);
+									mCachedWriteIndex = 0;
+								}
+								~SpscRing()
+								{
+									size_t	write = mWriteIndex.load(std::memory_order_acquire);
+									for (size_t read = mReadIndex.load(std::memory_order_relaxed); read != write; read++)
+										mBuffer[read & mMask].~T();
+									::operator delete(mBuffer);
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Producer: returns false if the ring is full
+		bool					tryPush(const T &inItem)
+		{
+			return tryEmplace(inItem);
+		}
+		bool					tryPush(T &&inItem)
+		{
+			return tryEmplace(std::move(inItem));
+		}
+		template <class... Args>
+		bool					tryEmplace(Args&&... inArgs)
+		{
+			size_t	write = mWriteIndex.load(std::memory_order_relaxed);
+			if (write - mCachedReadIndex == mCapacity)
+			{
+				mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+				if (write - mCachedReadIndex == mCapacity)
+					return false;
+			}
+			new (&mBuffer[write & mMask]) T(std::forward<Args>(inArgs)...);
+			mWriteIndex.store(write + 1, std::memory_order_release);
+			return true;
+		}
+		//	Producer: copies as many of inItems as fit with one index update
+		//	and returns that number
+		size_t					pushBulk(const T *inItems, size_t inNum)
+		{
+			size_t	write = mWriteIndex.load(std::memory_order_relaxed);
+			size_t	room = mCapacity - (write - mCachedReadIndex);
+			if (room < inNum)
+			{
+				mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+				room = mCapacity - (write - mCachedReadIndex);
+			}
+			if (inNum > room)
+				inNum = room;
+
+			for (size_t i = 0; i < inNum; i++)
+				new (&mBuffer[(write + i) & mMask]) T(inItems[i]);
+			if (inNum != 0)
+				mWriteIndex.store(write + inNum, std::memory_order_release);
+			return inNum;
+		}
+		//	Consumer: returns false if the ring is empty
+		bool					tryPop(T *outItem)
+		{
+			size_t	read = mReadIndex.load(std::memory_order_relaxed);
+			if (read == mCachedWriteIndex)
+			{
+				mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+				if (read == mCachedWriteIndex)
+					return false;
+			}
+			T	*item = &mBuffer[read & mMask];
+			*outItem = std::move(*item);
+			item->~T();
+			mReadIndex.store(read + 1, std::memory_order_release);
+			return true;
+		}
+		//	Consumer: moves up to inNum items out with one index update and
+		//	returns the number taken
+		size_t					popBulk(T *outItems, size_t inNum)
+		{
+			size_t	read = mReadIndex.load(std::memory_order_relaxed);
+			size_t	available = mCachedWriteIndex - read;
+			if (available < inNum)
+			{
+				mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+				available = mCachedWriteIndex - read;
+			}
+			if (inNum > available)
+				inNum = available;
+
+			for (size_t i = 0; i < inNum; i++)
+			{
+				T	*item = &mBuffer[(read + i) & mMask];
+				outItems[i] = std::move(*item);
+				item->~T();
+			}
+			if (inNum != 0)
+				mReadIndex.store(read + inNum, std::memory_order_release);
+			return inNum;
+		}
+		//	A snapshot; exact only when called from one of the two sides
+		//	while the other is idle
+		size_t					getSize() const
+		{
+			size_t	read = mReadIndex.load(std::memory_order_acquire);
+			return mWriteIndex.load(std::memory_order_acquire) - read;
+		}
+		bool					isEmpty() const
+		{
+			return (getSize() == 0);
+		}
+		size_t					getCapacity() const
+		{
+			return mCapacity;
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		CACHE_LINE_SIZE						= 64;
+		const static size_t		MAX_CAPACITY						= ((size_t )-1 >> 1) / sizeof(T);
+		static_assert(alignof(T) <= alignof(std::max_align_t), "T is over-aligned for SpscRing");
+
+		// Member Variables ----------------------------------------------------
+		//	Read-only after construction
+		alignas(CACHE_LINE_SIZE) T	*mBuffer;
+		size_t					mCapacity;
+		size_t					mMask;
+		//	Producer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t>	mWriteIndex;
+		size_t					mCachedReadIndex;
+		//	Consumer side
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t>	mReadIndex;
+		size_t					mCachedWriteIndex;
+		char					mPad[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+								SpscRing(const SpscRing &);
+		SpscRing				&operator=(const SpscRing &);
+	};
+
+	// -------------------------------------------------------------------------
+	// BlockingSpscRing class
+	// -------------------------------------------------------------------------
+	//	SpscRing with push/pop functions that wait while the ring is full or
+	//	empty. A side sets its waiting flag before sleeping on its Event;
+	//	the other side only calls signal() when it finds the flag set, so a
+	//	stream that never waits never makes a system call.
+	template <class T>
+	class	BlockingSpscRing
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								BlockingSpscRing(size_t inCapacity)
+									: mRing(inCapacity)
+								{
+									mIsProducerWaiting.store(false, std::memory_order_relaxed);
+									mIsConsumerWaiting.store(false, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Producer: returns false if there was no room before inDeadline
+		bool					push(const T &inItem, const Deadline &inDeadline = Deadline::infinite())
+		{
+			for (;;)
+			{
+				if (mRing.tryPush(inItem) != false)
+				{
+					notify(&mIsConsumerWaiting, &mNotEmptyEvent);
+					return true;
+				}
+				if (waitOther(&mIsProducerWaiting, &mNotFullEvent, inDeadline) == false)
+					return false;
+			}
+		}
+		bool					push(T &&inItem, const Deadline &inDeadline = Deadline::infinite())
+		{
+			for (;;)
+			{
+				if (mRing.tryPush(std::move(inItem)) != false)
+				{
+					notify(&mIsConsumerWaiting, &mNotEmptyEvent);
+					return true;
+				}
+				if (waitOther(&mIsProducerWaiting, &mNotFullEvent, inDeadline) == false)
+					return false;
+			}
+		}
+		//	Producer: pushes all of inItems, waiting for room as needed.
+		//	Returns the number pushed, less than inNum only on timeout.
+		size_t					pushBulk(const T *inItems, size_t inNum, const Deadline &inDeadline = Deadline::infinite())
+		{
+			size_t	pushed = 0;
+			for (;;)
+			{
+				size_t	num = mRing.pushBulk(inItems + pushed, inNum - pushed);
+				if (num != 0)
+				{
+					pushed += num;
+					notify(&mIsConsumerWaiting, &mNotEmptyEvent);
+				}
+				if (pushed == inNum)
+					return pushed;
+				if (waitOther(&mIsProducerWaiting, &mNotFullEvent, inDeadline) == false)
+					return pushed;
+			}
+		}
+		//	Consumer: returns false if nothing arrived before inDeadline
+		bool					pop(T *outItem, const Deadline &inDeadline = Deadline::infinite())
+		{
+			for (;;)
+			{
+				if (mRing.tryPop(outItem) != false)
+				{
+					notify(&mIsProducerWaiting, &mNotFullEvent);
+					return true;
+				}
+				if (waitOther(&mIsConsumerWaiting, &mNotEmptyEvent, inDeadline) == false)
+					return false;
+			}
+		}
+		//	Consumer: waits for at least one item, then takes up to inNum.
+		//	Returns 0 on timeout.
+		size_t					popBulk(T *outItems, size_t inNum, const Deadline &inDeadline = Deadline::infinite())
+		{
+			for (;;)
+			{
+				size_t	num = mRing.popBulk(outItems, inNum);
+				if (num != 0 || inNum == 0)
+				{
+					if (num != 0)
+						notify(&mIsProducerWaiting, &mNotFullEvent);
+					return num;
+				}
+				if (waitOther(&mIsConsumerWaiting, &mNotEmptyEvent, inDeadline) == false)
+					return 0;
+			}
+		}
+		//	Non-blocking access; the owning side must still notify through
+		//	push()/pop() if the other side may be waiting
+		SpscRing<T>				&getRing()
+		{
+			return mRing;
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		//	Pairs with waitOther(): the index update and the flag load are
+		//	ordered by the fence, as are the flag store and the retry there
+		static void				notify(std::atomic<bool> *inIsWaiting, Event *inEvent)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (inIsWaiting->load(std::memory_order_relaxed) != false &&
+				inIsWaiting->exchange(false, std::memory_order_relaxed) != false)
+				inEvent->signal();
+		}
+		//	Returns false on timeout. The caller retries its operation after
+		//	a true return; a stale signal only costs one extra retry.
+		bool					waitOther(std::atomic<bool> *inIsWaiting, Event *inEvent, const Deadline &inDeadline)
+		{
+			inIsWaiting->store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (isReady(inIsWaiting) != false)
+			{
+				inIsWaiting->store(false, std::memory_order_relaxed);
+				return true;
+			}
+			if (inEvent->waitUntil(inDeadline) != false)
+				return true;
+			inIsWaiting->store(false, std::memory_order_relaxed);
+			return isReady(inIsWaiting);
+		}
+		bool					isReady(const std::atomic<bool> *inIsWaiting) const
+		{
+			if (inIsWaiting == &mIsConsumerWaiting)
+				return (mRing.isEmpty() == false);
+			return (mRing.getSize() < mRing.getCapacity());
+		}
+
+		// Member Variables ----------------------------------------------------
+		SpscRing<T>				mRing;
+		std::atomic<bool>		mIsProducerWaiting;
+		std::atomic<bool>		mIsConsumerWaiting;
+		Event					mNotEmptyEvent;
+		Event					mNotFullEvent;
+
+								BlockingSpscRing(const BlockingSpscRing &);
+		BlockingSpscRing		&operator=(const BlockingSpscRing &);
+	};
+}
+
+#endif // TBC_SPSC_RING_HPP
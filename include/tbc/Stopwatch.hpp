@@ -0,0 +1,123 @@
+// =============================================================================
+//  Stopwatch.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/Stopwatch.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc stopwatch
+
+	This file defines a nanosecond stopwatch on top of tbc::Clock
+*/
+
+#ifndef TBC_STOPWATCH_HPP
+#define TBC_STOPWATCH_HPP
+
+// Includes --------------------------------------------------------------------
+#include "tbc/Clock.hpp"
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// Stopwatch class
+	// -------------------------------------------------------------------------
+	class	Stopwatch
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+		//	The stopwatch starts running on construction. With inIsFast it
+		//	reads Clock::getFastNanoseconds() (TSC) instead of the OS clock.
+								Stopwatch(bool inIsFast = false)
+								{
+									mIsFast = inIsFast;
+									mAccumulated = 0;
+									mIsRunning = true;
+									mStartTime = now();
+									mLapTime = mStartTime;
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					start()
+		{
+			if (mIsRunning != false)
+				return;
+			mStartTime = now();
+			mLapTime = mStartTime;
+			mIsRunning = true;
+		}
+		void					stop()
+		{
+			if (mIsRunning == false)
+				return;
+			mAccumulated += now() - mStartTime;
+			mIsRunning = false;
+		}
+		void					reset()
+		{
+			mAccumulated = 0;
+			mStartTime = now();
+			mLapTime = mStartTime;
+		}
+		void					restart()
+		{
+			reset();
+			mIsRunning = true;
+		}
+		bool					isRunning() const
+		{
+			return mIsRunning;
+		}
+		uint64_t				getElapsed() const
+		{
+			if (mIsRunning == false)
+				return mAccumulated;
+			return mAccumulated + now() - mStartTime;
+		}
+		uint64_t				getElapsedMicroseconds() const
+		{
+			return getElapsed() / (Clock::NANO_SECOND_UNIT / Clock::MICRO_SECOND_UNIT);
+		}
+		uint64_t				getElapsedMilliseconds() const
+		{
+			return getElapsed() / (Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT);
+		}
+		//	Returns the nanoseconds since the previous lap() (or start)
+		uint64_t				lap()
+		{
+			uint64_t	t = now();
+			uint64_t	elapsed = t - mLapTime;
+
+			mLapTime = t;
+			return elapsed;
+		}
+
+	private:
+		// Member Functions ----------------------------------------------------
+		uint64_t				now() const
+		{
+			if (mIsFast != false)
+				return Clock::getFastNanoseconds();
+			return Clock::getNanoseconds();
+		}
+
+		// Member Variables ----------------------------------------------------
+		bool					mIsFast;
+		bool					mIsRunning;
+		uint64_t				mStartTime;
+		uint64_t				mLapTime;
+		uint64_t				mAccumulated;
+	};
+}
+
+#endif // TBC_STOPWATCH_HPP
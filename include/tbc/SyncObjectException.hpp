@@ -24,7 +24,7 @@
 #define TBC_SYNC_OBJECT_EXCEPTION_HPP
 
 // Includes --------------------------------------------------------------------
-#include "tbc/Exception"
+#include "tbc/Exception.hpp"
 
 // Namespace -------------------------------------------------------------------
 namespace tbc
@@ -24,11 +24,21 @@
 #define TBC_THREAD_H
 
 // Includes --------------------------------------------------------------------
-#include "tbc/ThreadException.h"
+#include "tbc/ThreadException.hpp"
+#include "tbc/Mutex.hpp"
+#include "tbc/CpuSet.hpp"
+#include "tbc/Clock.hpp"
 #ifdef _WIN32	//	Win32 specific ---------------------------------------------
 //	none
 #elif _PTHREAD	//	pthread specific -------------------------------------------
  #include <pthread.h>
+ #include <sched.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <sys/resource.h>
+ #ifdef __linux__
+  #include <sys/syscall.h>
+ #endif
   #ifdef TBC_USE_CLOCK_GETTIME_
    #include <time.h>
   #endif
@@ -49,6 +59,16 @@ namespace tbc
 	class	Thread
 	{
 	public:
+		// Constatns -----------------------------------------------------------
+		enum SchedPolicy
+		{
+			SCHED_POLICY_OTHER		= 0,
+			SCHED_POLICY_FIFO,
+			SCHED_POLICY_RR,
+			SCHED_POLICY_BATCH,
+			SCHED_POLICY_IDLE
+		};
+
 		// Constructors and Destructor -----------------------------------------
 		// Destructor ----------------------------------------------------------
 		virtual					~Thread()
@@ -64,8 +84,12 @@ namespace tbc
 				catch(...)
 				{
 				}
+				if (isParked() != false)
+					exitParkedThread();
 				::CloseHandle(mThread);
 			}
+			::CloseHandle(mParkEvent);
+			::CloseHandle(mDoneEvent);
 		#elif _PTHREAD	//	pthread specific -----------------------------------
 			if (mIsThreadStarted != false)
 			{
@@ -77,11 +101,17 @@ namespace tbc
 				catch(...)
 				{
 				}
+				if (isParked() != false)
+					exitParkedThread();
 			}
+			pthread_cond_destroy(&mParkCond);
+			pthread_mutex_destroy(&mParkMutex);
 		#endif	// specific parts end ------------------------------------------
 		}
 
 		// Member Functions ----------------------------------------------------
+		//	Throws OS_ERROR if the schedule, affinity or NUMA node set before
+		//	could not be applied; the thread is running all the same
 		void					start()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
@@ -89,25 +119,50 @@ namespace tbc
 			{
 				if (mThread != NULL)
 				{
-					if (::WaitForSingleObject(mThread, 0) != WAIT_OBJECT_0)
+					if (isParked() != false)
+					{
+						::ResetEvent(mDoneEvent);
+						::SetEvent(mParkEvent);
+						mCallMutex.unlock();
+						return;
+					}
+					if (isAlive() != false)
 					{
 						mCallMutex.unlock();
 						throw ThreadException( Exception::PARAM_ERROR,
 								"Thread is already started", TBC_EXCEPTION_LOCATION_MACRO);
 					}
+					//	runner() has returned, the thread may still be exiting
+					::WaitForSingleObject(mThread, INFINITE);
 					::CloseHandle(mThread);
 				}
 
+				mIsThreadReusable = mIsReusable;
+				::ResetEvent(mDoneEvent);
 				DWORD	threadID;
-				mThread = ::CreateThread(NULL, 0,
-										(LPTHREAD_START_ROUTINE )ThreadEntryFunc, (LPVOID )this,
-										0, &threadID);
+				DWORD	flags = CREATE_SUSPENDED;
+				if (mStackSize != 0)
+					flags |= STACK_SIZE_PARAM_IS_A_RESERVATION;
+				mThread = ::CreateThread(NULL, mStackSize,
+										(LPTHREAD_START_ROUTINE )threadEntryFunc, (LPVOID )this,
+										flags, &threadID);
 				if (mThread == NULL)
 				{
 					mCallMutex.unlock();
 					throw ThreadException( Exception::OS_ERROR,
 							"mThread == NULL", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
 				}
+
+				DWORD	error = applySchedule();
+				if (error == 0)
+					error = applyAffinity();
+				::ResumeThread(mThread);
+				if (error != 0)
+				{
+					mCallMutex.unlock();
+					throw ThreadException( Exception::OS_ERROR,
+							"applySchedule() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				}
 			}
 			mCallMutex.unlock();
 		#elif _PTHREAD	//	pthread specific -----------------------------------
@@ -119,8 +174,47 @@ namespace tbc
 					throw ThreadException( Exception::PARAM_ERROR,
 							"Thread is already started", TBC_EXCEPTION_LOCATION_MACRO);
 				}
+				if (mIsThreadStarted != false)
+				{
+					if (mIsThreadReusable != false)
+					{
+						pthread_mutex_lock(&mParkMutex);
+						mIsThreadStopped = false;
+						mIsStartRequested = true;
+						mIsScheduleApplied = false;
+						pthread_cond_broadcast(&mParkCond);
+						pthread_mutex_unlock(&mParkMutex);
+						int	error = waitScheduleApplied();
+						mCallMutex.unlock();
+						if (error != 0)
+						{
+							throw ThreadException( Exception::OS_ERROR,
+									"applyThreadLocalSchedule() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+						}
+						return;
+					}
+					//	Reap the previous thread if it was never joined
+					if (mIsThreadJoined == false)
+						pthread_join(mThread, NULL);
+					mIsThreadStarted = false;
+				}
 
-				int error = pthread_create(&mThread, NULL, ThreadEntryFunc, (void *)this);
+				pthread_attr_t	attr;
+				int error = initThreadAttr(&attr);
+				if (error != 0)
+				{
+					mCallMutex.unlock();
+					throw ThreadException( Exception::OS_ERROR,
+							"initThreadAttr() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				}
+
+				mIsThreadStopped = false;
+				mIsThreadJoined = false;
+				mIsThreadReusable = mIsReusable;
+				mThreadID = 0;
+				mIsScheduleApplied = false;
+				error = pthread_create(&mThread, &attr, threadEntryFunc, (void *)this);
+				pthread_attr_destroy(&attr);
 				if (error != 0)
 				{
 					mCallMutex.unlock();
@@ -128,6 +222,15 @@ namespace tbc
 							"mThread == NUL", TBC_EXCEPTION_LOCATION_MACRO, error);
 				}
 				mIsThreadStarted = true;
+
+				//	Also publishes mThreadID before start() returns
+				error = waitScheduleApplied();
+				if (error != 0)
+				{
+					mCallMutex.unlock();
+					throw ThreadException( Exception::OS_ERROR,
+							"applyThreadLocalSchedule() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				}
 			}
 			mCallMutex.unlock();
 		#endif	// specific parts end ------------------------------------------
@@ -143,7 +246,7 @@ namespace tbc
 
 			mCallMutex.lock();
 			{
-				if (::WaitForSingleObject(mThread, 0) == WAIT_OBJECT_0)
+				if (isAlive() == false)
 				{
 					mCallMutex.unlock();
 					return;
@@ -177,14 +280,17 @@ namespace tbc
 						"Thread is not started", TBC_EXCEPTION_LOCATION_MACRO);
 			}
 
-			DWORD   result = ::WaitForSingleObject(mThread, INFINITE);
-			if (result == WAIT_ABANDONED)
+			//	mDoneEvent is set when runner() returns, also for a thread that
+			//	parks in reusable mode
+			HANDLE	handles[2] = { mDoneEvent, mThread };
+			DWORD   result = ::WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+			if (result == WAIT_ABANDONED_0 || result == WAIT_ABANDONED_0 + 1)
 			{
 				throw ThreadException( Exception::THREAD_CANCELED,
 						"result == WAIT_ABANDONED", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
 			}
 
-			if (result != WAIT_OBJECT_0)
+			if (result != WAIT_OBJECT_0 && result != WAIT_OBJECT_0 + 1)
 			{
 				throw ThreadException( Exception::OS_ERROR,
 						"result != WAIT_OBJECT_0", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
@@ -198,6 +304,21 @@ namespace tbc
 						"Thread is not started", TBC_EXCEPTION_LOCATION_MACRO);
 			}
 
+			if (mIsThreadReusable != false)
+			{
+				//	The OS thread parks instead of exiting; wait for runner()
+				pthread_mutex_lock(&mParkMutex);
+				while (mIsThreadStopped == false)
+					pthread_cond_wait(&mParkCond, &mParkMutex);
+				pthread_mutex_unlock(&mParkMutex);
+				return;
+			}
+
+			//	The thread stays started (and signalStop() a no-op) until the
+			//	next start(); a second join() returns at once
+			if (mIsThreadJoined != false)
+				return;
+
 			void	*valuePtr;
 			int error = pthread_join(mThread, &valuePtr);
 			if (error != 0)
@@ -205,6 +326,7 @@ namespace tbc
 				throw ThreadException( Exception::OS_ERROR,
 						"pthread_join() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
 			}
+			mIsThreadJoined = true;
 
 			return;
 		#endif	// specific parts end ------------------------------------------
@@ -218,6 +340,9 @@ namespace tbc
 			if (::WaitForSingleObject(mThread, 0) == WAIT_OBJECT_0)
 				return false;
 
+			if (::WaitForSingleObject(mDoneEvent, 0) == WAIT_OBJECT_0)
+				return false;
+
 			return true;
 		#elif _PTHREAD	//	pthread specific -----------------------------------
 			if (mIsThreadStarted == false)
@@ -229,20 +354,240 @@ namespace tbc
 			return true;
 		#endif	// specific parts end ------------------------------------------
 		}
+		//	In reusable mode the OS thread does not exit when runner() returns.
+		//	It parks and runs runner() again at the next start(), so a restart
+		//	costs a wakeup instead of a thread creation. isAlive() and join()
+		//	behave as before. The mode is taken when the OS thread is created;
+		//	setReusable(false) terminates a parked thread.
+		void					setReusable(bool inIsReusable)
+		{
+			mCallMutex.lock();
+			{
+				mIsReusable = inIsReusable;
+				if (inIsReusable == false && isParked() != false)
+					exitParkedThread();
+			}
+			mCallMutex.unlock();
+		}
+		bool					isReusable() const
+		{
+			return mIsReusable;
+		}
+		//	Scheduling settings may be changed before start() or while the
+		//	thread is running. Settings made before start() are applied when
+		//	the thread is created and kept for every later start().
+		//
+		//	pthread: for SCHED_POLICY_FIFO and SCHED_POLICY_RR the priority is
+		//	the real-time priority (see getMinPriority()/getMaxPriority()).
+		//	For the other policies it is the nice value of the thread.
+		//	Win32: the policy is not used and the priority is one of the
+		//	THREAD_PRIORITY_* values.
+		void					setSchedPolicy(SchedPolicy inPolicy, int inPriority)
+		{
+			mCallMutex.lock();
+			{
+				mSchedPolicy = inPolicy;
+				mPriority = inPriority;
+				mIsSchedSet = true;
+
+				if (isAttached() != false)
+				{
+					int	error = (int )applySchedule();
+					if (error != 0)
+					{
+						mCallMutex.unlock();
+						throw ThreadException( Exception::OS_ERROR,
+								"applySchedule() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					}
+				}
+			}
+			mCallMutex.unlock();
+		}
+		SchedPolicy				getSchedPolicy() const
+		{
+			return mSchedPolicy;
+		}
 		void					setPriority(int inPriority)
+		{
+			setSchedPolicy(mSchedPolicy, inPriority);
+		}
+		int						getPriority()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			if (isAttached() == false)
+				return mPriority;
+
+			int	priority = ::GetThreadPriority(mThread);
+			if (priority == THREAD_PRIORITY_ERROR_RETURN)
+			{
+				throw ThreadException( Exception::OS_ERROR,
+						"::GetThreadPriority() failed", TBC_EXCEPTION_LOCATION_MACRO, ::GetLastError());
+			}
+			return priority;
 		#elif _PTHREAD	//	pthread specific -----------------------------------
+			if (isAttached() == false)
+				return mPriority;
+
+			if (isRealTimePolicy(mSchedPolicy) != false)
+			{
+				struct sched_param	param;
+				int					policy;
+
+				int error = pthread_getschedparam(mThread, &policy, &param);
+				if (error != 0)
+				{
+					throw ThreadException( Exception::OS_ERROR,
+							"pthread_getschedparam() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+				}
+				return param.sched_priority;
+			}
+
+			if (mThreadID == 0)
+				return mPriority;
+
+			errno = 0;
+			int	priority = getpriority(PRIO_PROCESS, (id_t )mThreadID);
+			if (priority == -1 && errno != 0)
+			{
+				throw ThreadException( Exception::OS_ERROR,
+						"getpriority() failed", TBC_EXCEPTION_LOCATION_MACRO, errno);
+			}
+			return priority;
 		#endif	// specific parts end ------------------------------------------
 		}
-		int						getPriority()
+		//	Pins the thread to the CPUs in inCpuSet. An empty set removes the
+		//	pinning again at the next start() (or the NUMA node CPUs are used
+		//	if a node is set).
+		void					setAffinity(const CpuSet &inCpuSet)
+		{
+			mCallMutex.lock();
+			{
+				mAffinity = inCpuSet;
+				mIsAffinitySet = (inCpuSet.isEmpty() == false);
+
+				if (isAttached() != false && mIsAffinitySet != false)
+				{
+					int	error = (int )applyAffinity();
+					if (error != 0)
+					{
+						mCallMutex.unlock();
+						throw ThreadException( Exception::OS_ERROR,
+								"applyAffinity() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					}
+				}
+			}
+			mCallMutex.unlock();
+		}
+		void					getAffinity(CpuSet *outCpuSet)
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
-			return 0;
+			getEffectiveAffinity(outCpuSet);
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-			return 0;
+			if (isAttached() == false)
+			{
+				getEffectiveAffinity(outCpuSet);
+				return;
+			}
+
+		 #ifdef TBC_CPU_SET_HAS_NATIVE
+			cpu_set_t	nativeSet;
+			int error = pthread_getaffinity_np(mThread, sizeof(nativeSet), &nativeSet);
+			if (error != 0)
+			{
+				throw ThreadException( Exception::OS_ERROR,
+						"pthread_getaffinity_np() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+			}
+			outCpuSet->setNativeCpuSet(&nativeSet);
+		 #else
+			getEffectiveAffinity(outCpuSet);
+		 #endif
 		#endif	// specific parts end ------------------------------------------
 		}
+		//	Prefers a NUMA node (-1 for none). Unless an explicit affinity is
+		//	set, the thread is kept on the CPUs of the node. On Linux, memory
+		//	allocated by the thread is also preferred from the node; this part
+		//	takes effect at the next start() because the memory policy can
+		//	only be changed by the thread itself.
+		void					setNumaNode(int inNode)
+		{
+			mCallMutex.lock();
+			{
+				mNumaNode = inNode;
+
+				if (isAttached() != false && mIsAffinitySet == false && inNode >= 0)
+				{
+					int	error = (int )applyAffinity();
+					if (error != 0)
+					{
+						mCallMutex.unlock();
+						throw ThreadException( Exception::OS_ERROR,
+								"applyAffinity() failed", TBC_EXCEPTION_LOCATION_MACRO, error);
+					}
+				}
+			}
+			mCallMutex.unlock();
+		}
+		int						getNumaNode() const
+		{
+			return mNumaNode;
+		}
+		//	Stack settings take effect when the OS thread is created, i.e. at
+		//	start() (a parked reusable thread keeps its stack). A stack size
+		//	of 0 keeps the system default (8 MB reservation on most Linux
+		//	systems). Win32 only uses the stack size.
+		void					setStackSize(size_t inBytes)
+		{
+			mCallMutex.lock();
+			{
+				mStackSize = inBytes;
+			}
+			mCallMutex.unlock();
+		}
+		size_t					getStackSize() const
+		{
+			return mStackSize;
+		}
+		//	Size of the inaccessible area below the stack that turns an
+		//	overflow into a fault. 0 disables it.
+		void					setGuardSize(size_t inBytes)
+		{
+			mCallMutex.lock();
+			{
+				mGuardSize = inBytes;
+				mIsGuardSizeSet = true;
+			}
+			mCallMutex.unlock();
+		}
+		size_t					getGuardSize() const
+		{
+			return mGuardSize;
+		}
+		//	Runs the thread on memory owned by the caller (NULL reverts to a
+		//	system allocated stack). The memory must stay valid until the
+		//	thread is joined, and no guard area is added to it.
+		void					setStack(void *inStack, size_t inSize)
+		{
+			mCallMutex.lock();
+			{
+				mStack = inStack;
+				mStackSize = (inStack != NULL) ? inSize : 0;
+			}
+			mCallMutex.unlock();
+		}
+		//	When enabled, the unused stack is filled with a pattern before each
+		//	runner() call and scanned after it returns. Painting touches the
+		//	whole stack, so use it together with setStackSize() when sizing
+		//	stacks, not on production threads with large stacks.
+		void					setStackTracking(bool inIsEnabled)
+		{
+			mIsStackTracking = inIsEnabled;
+		}
+		//	Peak stack usage in bytes of the last completed runner() call;
+		//	0 if tracking was disabled or is not supported (Win32)
+		size_t					getPeakStackUsage() const
+		{
+			return mPeakStackUsage;
+		}
 
 		// Static Functions ----------------------------------------------------
 		static void				sleep(timeout_t inMilliseconds)
@@ -261,34 +606,44 @@ namespace tbc
 			//usleep(inMilliseconds * 1000);  // microseconds to miliseconds
 		#endif	// specific parts end ------------------------------------------
 		}
+		//	Gives up the rest of the time slice to other runnable threads
+		static void				yield()
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			::SwitchToThread();
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			sched_yield();
+		#endif	// specific parts end ------------------------------------------
+		}
+		//	Milliseconds on a monotonic clock. The value is 32 bits wide and
+		//	wraps after about 49.7 days, so only differences are meaningful.
+		//	New code should use Clock, Stopwatch or Deadline instead.
 		static unsigned int		getTickCount()
 		{
 		#ifdef _WIN32	//	Win32 specific -------------------------------------
 			return ::GetTickCount();
 		#elif _PTHREAD	//	pthread specific -----------------------------------
-		 #ifdef TBC_USE_CLOCK_GETTIME
-			unsigned int    tick;
-			struct timespec t;
-
-			clock_gettime(CLOCK_REALTIME, &t);
-			tick = t.tv_sec * MILLI_SECOND_UNIT;
-			tick += (t.tv_nsec / MICRO_SECOND_UNIT);
-
-			return tick;
-		 #else
-			unsigned int    tick;
-			int		error;
-			struct timeval  timeVal;
-			struct timezone timeZone;
-
-			error = gettimeofday(&timeVal, &timeZone);
-			if (error != 0)
-				return 0;
-
-			tick = timeVal.tv_sec * MILLI_SECOND_UNIT;
-			tick += (timeVal.tv_usec / MILLI_SECOND_UNIT);
-
-			return tick;
+			return (unsigned int )Clock::getMilliseconds();
+		#endif	// specific parts end ------------------------------------------
+		}
+		static int				getMinPriority(SchedPolicy inPolicy)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			return THREAD_PRIORITY_IDLE;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			if (isRealTimePolicy(inPolicy) == false)
+				return 19;
+			return sched_get_priority_min(getNativePolicy(inPolicy));
+		#endif	// specific parts end ------------------------------------------
+		}
+		static int				getMaxPriority(SchedPolicy inPolicy)
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			return THREAD_PRIORITY_TIME_CRITICAL;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			if (isRealTimePolicy(inPolicy) == false)
+				return -20;
+			return sched_get_priority_max(getNativePolicy(inPolicy));
 		#endif	// specific parts end ------------------------------------------
 		}
 	//	pthread specific -------------------------------------------------------
@@ -360,12 +715,37 @@ namespace tbc
 		// Constructors --------------------------------------------------------
 								Thread()
 								{
+									mSchedPolicy = SCHED_POLICY_OTHER;
+									mPriority = 0;
+									mIsSchedSet = false;
+									mIsAffinitySet = false;
+									mNumaNode = -1;
+									mStackSize = 0;
+									mGuardSize = 0;
+									mIsGuardSizeSet = false;
+									mStack = NULL;
+									mIsStackTracking = false;
+									mPeakStackUsage = 0;
+									mIsReusable = false;
+									mIsThreadReusable = false;
+									mIsExitRequested = false;
 								#ifdef _WIN32	//	Win32 specific -------------
 									mThread = NULL;
+									mParkEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+									mDoneEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
 								#elif _PTHREAD	//	pthread specific -----------
 
 									mIsThreadStarted = false;
 									mIsThreadStopped = false;
+									mIsThreadJoined = false;
+									mIsStartRequested = false;
+									mThreadID = 0;
+									mIsScheduleApplied = false;
+									mScheduleError = 0;
+									mStackLow = NULL;
+									mStackHigh = NULL;
+									pthread_mutex_init(&mParkMutex, NULL);
+									pthread_cond_init(&mParkCond, NULL);
 								#endif	// specific parts end ------------------
 								}
 
@@ -379,29 +759,406 @@ namespace tbc
 		virtual void			stopper() = 0;
 
 	private:
+		// Constatns -----------------------------------------------------------
+		const static int		MPOL_PREFERRED_MODE					= 1;
+		const static int		NUMA_NODE_MASK_WORDS				= 16;
+		const static unsigned char	STACK_PAINT_BYTE				= 0xA5;
+		const static size_t		STACK_PAINT_MARGIN					= 4096;
+
+		// Member Functions ----------------------------------------------------
+		bool					getEffectiveAffinity(CpuSet *outCpuSet)
+		{
+			if (mIsAffinitySet != false)
+			{
+				*outCpuSet = mAffinity;
+				return true;
+			}
+
+			if (mNumaNode >= 0 && outCpuSet->setNumaNode(mNumaNode) != false)
+				return true;
+
+			outCpuSet->clearAll();
+			return false;
+		}
+		//	The OS thread exists, running or parked
+		bool					isAttached() const
+		{
+			return (isAlive() != false || isParked() != false);
+		}
+
 		// Member Variables ----------------------------------------------------
 		Mutex					mCallMutex;
+		SchedPolicy				mSchedPolicy;
+		int						mPriority;
+		bool					mIsSchedSet;
+		CpuSet					mAffinity;
+		bool					mIsAffinitySet;
+		int						mNumaNode;
+		size_t					mStackSize;
+		size_t					mGuardSize;
+		bool					mIsGuardSizeSet;
+		void					*mStack;
+		bool					mIsStackTracking;
+		size_t					mPeakStackUsage;
+		bool					mIsReusable;
+		bool					mIsThreadReusable;
+		bool					mIsExitRequested;
 
 	#ifdef _WIN32	//	Win32 specific -----------------------------------------
 		static DWORD			threadEntryFunc(void *inObjPtr)
 		{
-			((MyThread *)inObjPtr)->runner();
+			Thread	*thread = (Thread *)inObjPtr;
+
+			do
+			{
+				thread->runner();
+			}
+			while (thread->park() != false);
+
+			return 0;
+		}
+		//	Returns true if the thread should run runner() again
+		bool					park()
+		{
+			::SetEvent(mDoneEvent);
+			if (mIsThreadReusable == false)
+				return false;
+
+			::WaitForSingleObject(mParkEvent, INFINITE);
+			return (mIsExitRequested == false);
+		}
+		bool					isParked() const
+		{
+			if (mThread == NULL || mIsThreadReusable == false)
+				return false;
+			if (::WaitForSingleObject(mThread, 0) == WAIT_OBJECT_0)
+				return false;
+			return (::WaitForSingleObject(mDoneEvent, 0) == WAIT_OBJECT_0);
+		}
+		void					exitParkedThread()
+		{
+			mIsExitRequested = true;
+			::SetEvent(mParkEvent);
+			::WaitForSingleObject(mThread, INFINITE);
+			mIsExitRequested = false;
+		}
+		DWORD					applySchedule()
+		{
+			if (mIsSchedSet == false)
+				return 0;
+
+			if (::SetThreadPriority(mThread, mPriority) == false)
+				return ::GetLastError();
+			return 0;
+		}
+		DWORD					applyAffinity()
+		{
+			CpuSet	cpuSet;
+
+			if (getEffectiveAffinity(&cpuSet) == false)
+				return 0;
 
+			if (::SetThreadAffinityMask(mThread, cpuSet.getAffinityMask()) == 0)
+				return ::GetLastError();
 			return 0;
 		}
 
 		HANDLE					mThread;
+		HANDLE					mParkEvent;
+		HANDLE					mDoneEvent;
 	#elif _PTHREAD	//	pthread specific ---------------------------------------
 		static void				*threadEntryFunc(void *inObjPtr)
 		{
-			((MyThread *)inObjPtr)->runner();
-			((MyThread *)inObjPtr)->mIsThreadStopped = true;
+			Thread	*thread = (Thread *)inObjPtr;
+
+		#ifdef __linux__
+			thread->mThreadID = (pid_t )syscall(SYS_gettid);
+		#endif
+			do
+			{
+				thread->notifyScheduleApplied(thread->applyThreadLocalSchedule());
+				if (thread->mIsStackTracking != false)
+				{
+					thread->paintStack();
+					thread->runner();
+					thread->mPeakStackUsage = thread->measureStack();
+				}
+				else
+					thread->runner();
+			}
+			while (thread->park() != false);
 
 			return NULL;
 		}
+		//	Fills the stack between its lowest address and a margin below
+		//	the current frame with STACK_PAINT_BYTE
+		void					paintStack()
+		{
+			pthread_attr_t	attr;
+			void			*addr;
+			size_t			size;
+
+			mStackLow = NULL;
+			mStackHigh = NULL;
+			if (pthread_getattr_np(pthread_self(), &attr) != 0)
+				return;
+			int error = pthread_attr_getstack(&attr, &addr, &size);
+			pthread_attr_destroy(&attr);
+			if (error != 0)
+				return;
+
+			unsigned char	*low = (unsigned char *)addr;
+			unsigned char	*current = (unsigned char *)__builtin_frame_address(0);
+			if (current < low + STACK_PAINT_MARGIN || current > low + size)
+				return;
+
+			::memset(low, STACK_PAINT_BYTE, (current - STACK_PAINT_MARGIN) - low);
+			mStackLow = low;
+			mStackHigh = low + size;
+		}
+		size_t					measureStack() const
+		{
+			if (mStackLow == NULL)
+				return 0;
+
+			const unsigned char	*p = mStackLow;
+			while (p < mStackHigh && *p == STACK_PAINT_BYTE)
+				p++;
+			return (size_t )(mStackHigh - p);
+		}
+		//	Marks the thread stopped. In reusable mode the thread then waits
+		//	for the next start() and returns true to run runner() again.
+		bool					park()
+		{
+			pthread_mutex_lock(&mParkMutex);
+			mIsThreadStopped = true;
+			if (mIsThreadReusable == false)
+			{
+				pthread_mutex_unlock(&mParkMutex);
+				return false;
+			}
+
+			pthread_cond_broadcast(&mParkCond);
+			while (mIsStartRequested == false && mIsExitRequested == false)
+				pthread_cond_wait(&mParkCond, &mParkMutex);
+
+			bool	isRestart = (mIsExitRequested == false);
+			mIsStartRequested = false;
+			pthread_mutex_unlock(&mParkMutex);
+			return isRestart;
+		}
+		bool					isParked() const
+		{
+			return (mIsThreadStarted != false && mIsThreadReusable != false &&
+					mIsThreadStopped != false);
+		}
+		void					exitParkedThread()
+		{
+			pthread_mutex_lock(&mParkMutex);
+			mIsExitRequested = true;
+			pthread_cond_broadcast(&mParkCond);
+			pthread_mutex_unlock(&mParkMutex);
+
+			pthread_join(mThread, NULL);
+			mIsExitRequested = false;
+			mIsThreadReusable = false;
+			mIsThreadJoined = true;
+		}
+		static bool				isRealTimePolicy(SchedPolicy inPolicy)
+		{
+			return (inPolicy == SCHED_POLICY_FIFO || inPolicy == SCHED_POLICY_RR);
+		}
+		static int				getNativePolicy(SchedPolicy inPolicy)
+		{
+			switch (inPolicy)
+			{
+				case SCHED_POLICY_FIFO:
+					return SCHED_FIFO;
+				case SCHED_POLICY_RR:
+					return SCHED_RR;
+				case SCHED_POLICY_BATCH:
+					return SCHED_BATCH;
+				case SCHED_POLICY_IDLE:
+					return SCHED_IDLE;
+				default:
+					return SCHED_OTHER;
+			}
+		}
+		int						initThreadAttr(pthread_attr_t *outAttr)
+		{
+			int error = pthread_attr_init(outAttr);
+			if (error != 0)
+				return error;
+
+			//	pthread_attr_setschedpolicy() only takes SCHED_OTHER, SCHED_FIFO
+			//	and SCHED_RR; the other policies are set by the thread itself
+			//	in applyThreadLocalSchedule()
+			if (mIsSchedSet != false && isRealTimePolicy(mSchedPolicy) != false)
+			{
+				struct sched_param	param;
+
+				param.sched_priority = mPriority;
+				error = pthread_attr_setinheritsched(outAttr, PTHREAD_EXPLICIT_SCHED);
+				if (error == 0)
+					error = pthread_attr_setschedpolicy(outAttr, getNativePolicy(mSchedPolicy));
+				if (error == 0)
+					error = pthread_attr_setschedparam(outAttr, &param);
+				if (error != 0)
+				{
+					pthread_attr_destroy(outAttr);
+					return error;
+				}
+			}
+
+			if (mStack != NULL)
+				error = pthread_attr_setstack(outAttr, mStack, mStackSize);
+			else if (mStackSize != 0)
+				error = pthread_attr_setstacksize(outAttr, mStackSize);
+			if (error == 0 && mStack == NULL && mIsGuardSizeSet != false)
+				error = pthread_attr_setguardsize(outAttr, mGuardSize);
+			if (error != 0)
+			{
+				pthread_attr_destroy(outAttr);
+				return error;
+			}
+
+			CpuSet	cpuSet;
+			if (getEffectiveAffinity(&cpuSet) != false)
+			{
+			#ifdef TBC_CPU_SET_HAS_NATIVE
+				cpu_set_t	nativeSet;
+
+				cpuSet.getNativeCpuSet(&nativeSet);
+				error = pthread_attr_setaffinity_np(outAttr, sizeof(nativeSet), &nativeSet);
+			#else
+				error = ENOTSUP;
+			#endif
+				if (error != 0)
+				{
+					pthread_attr_destroy(outAttr);
+					return error;
+				}
+			}
+
+			return 0;
+		}
+		//	Parts of the schedule that only the thread itself can set.
+		//	Returns the errno of the first failure, or 0.
+		int						applyThreadLocalSchedule()
+		{
+			int	error = 0;
+
+			if (mIsSchedSet != false && isRealTimePolicy(mSchedPolicy) == false)
+			{
+				struct sched_param	param;
+
+				param.sched_priority = 0;
+				error = pthread_setschedparam(pthread_self(), getNativePolicy(mSchedPolicy), &param);
+			#ifdef __linux__
+				if (error == 0 && setpriority(PRIO_PROCESS, (id_t )mThreadID, mPriority) != 0)
+					error = errno;
+			#else
+				//	Elsewhere setpriority() would change the whole process
+				if (error == 0 && mPriority != 0)
+					error = ENOTSUP;
+			#endif
+			}
+
+		#ifndef __linux__
+			if (mNumaNode >= 0 && error == 0)
+				error = ENOTSUP;
+		#else
+			if (mNumaNode >= 0 && mNumaNode < NUMA_NODE_MASK_WORDS * 64)
+			{
+				unsigned long	nodeMask[NUMA_NODE_MASK_WORDS * 64 / (sizeof(unsigned long) * 8)];
+				const int		wordBits = sizeof(unsigned long) * 8;
+
+				::memset(nodeMask, 0, sizeof(nodeMask));
+				nodeMask[mNumaNode / wordBits] = 1UL << (mNumaNode % wordBits);
+				if (syscall(SYS_set_mempolicy, MPOL_PREFERRED_MODE, nodeMask, sizeof(nodeMask) * 8 + 1) != 0 &&
+					error == 0)
+					error = errno;
+			}
+		#endif
+			return error;
+		}
+		//	Called by the new thread before runner(). Also publishes
+		//	mThreadID to the thread waiting in start().
+		void					notifyScheduleApplied(int inError)
+		{
+			pthread_mutex_lock(&mParkMutex);
+			mScheduleError = inError;
+			mIsScheduleApplied = true;
+			pthread_cond_broadcast(&mParkCond);
+			pthread_mutex_unlock(&mParkMutex);
+		}
+		//	Called by start(). Returns the error of applyThreadLocalSchedule();
+		//	the thread runs runner() even if it failed, as on Win32.
+		int						waitScheduleApplied()
+		{
+			pthread_mutex_lock(&mParkMutex);
+			while (mIsScheduleApplied == false)
+				pthread_cond_wait(&mParkCond, &mParkMutex);
+			int	error = mScheduleError;
+			pthread_mutex_unlock(&mParkMutex);
+			return error;
+		}
+		int						applySchedule()
+		{
+			if (mIsSchedSet == false)
+				return 0;
+
+			struct sched_param	param;
+
+			param.sched_priority = 0;
+			if (isRealTimePolicy(mSchedPolicy) != false)
+				param.sched_priority = mPriority;
+
+			int error = pthread_setschedparam(mThread, getNativePolicy(mSchedPolicy), &param);
+			if (error != 0)
+				return error;
+
+		#ifdef __linux__
+			if (isRealTimePolicy(mSchedPolicy) == false && mThreadID != 0)
+			{
+				if (setpriority(PRIO_PROCESS, (id_t )mThreadID, mPriority) != 0)
+					return errno;
+			}
+		#else
+			if (isRealTimePolicy(mSchedPolicy) == false && mPriority != 0)
+				return ENOTSUP;
+		#endif
+
+			return 0;
+		}
+		int						applyAffinity()
+		{
+			CpuSet		cpuSet;
+
+			if (getEffectiveAffinity(&cpuSet) == false)
+				return 0;
+
+		#ifdef TBC_CPU_SET_HAS_NATIVE
+			cpu_set_t	nativeSet;
+
+			cpuSet.getNativeCpuSet(&nativeSet);
+			return pthread_setaffinity_np(mThread, sizeof(nativeSet), &nativeSet);
+		#else
+			return ENOTSUP;
+		#endif
+		}
 
 		pthread_t				mThread;
 		bool					mIsThreadStarted, mIsThreadStopped;
+		bool					mIsThreadJoined;	//	pthread_join() done for mThread
+		bool					mIsStartRequested;
+		bool					mIsScheduleApplied;	//	Guarded by mParkMutex
+		int						mScheduleError;
+		pid_t					mThreadID;			//	Published before start() returns
+		unsigned char			*mStackLow;
+		unsigned char			*mStackHigh;
+		pthread_mutex_t			mParkMutex;
+		pthread_cond_t			mParkCond;
 	#endif			// specific parts end --------------------------------------
 };
 
@@ -24,7 +24,7 @@
 #define TBC_THREAD_EXCEPTION_HPP
 
 // Includes --------------------------------------------------------------------
-#include "tbc/Exception"
+#include "tbc/Exception.hpp"
 
 // Namespace -------------------------------------------------------------------
 namespace tbc
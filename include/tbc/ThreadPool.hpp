@@ -0,0 +1,443 @@
+// =============================================================================
+//  ThreadPool.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/ThreadPool.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc work-stealing thread pool
+
+	This file defines a fixed-size thread pool. Every worker owns a task
+	deque; it pops its own tasks LIFO and steals FIFO from the other
+	workers when its own deque is empty.
+*/
+
+#ifndef TBC_THREAD_POOL_HPP
+#define TBC_THREAD_POOL_HPP
+
+// Includes --------------------------------------------------------------------
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <exception>
+#include "tbc/Thread.hpp"
+#include "tbc/Mutex.hpp"
+#include "tbc/Event.hpp"
+#include "tbc/Futex.hpp"
+#include "tbc/Deadline.hpp"
+#ifdef _WIN32	//	Win32 specific ---------------------------------------------
+//	none
+#elif _PTHREAD	//	pthread specific -------------------------------------------
+ #include <unistd.h>
+#endif			// specific parts end ------------------------------------------
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// ThreadPool class
+	// -------------------------------------------------------------------------
+	class	ThreadPool
+	{
+	public:
+		// ---------------------------------------------------------------------
+		// Task interface class
+		// ---------------------------------------------------------------------
+		//	Tasks are owned by the caller. The pool never deletes a task, and
+		//	it does not touch the task after run() returns, so a task may
+		//	delete itself at the end of run().
+		class	Task
+		{
+		public:
+			virtual					~Task() {}
+			virtual void			run() = 0;
+		};
+
+		// Constructors and Destructor -----------------------------------------
+								ThreadPool(unsigned int inThreadNum = 0)
+								{
+									if (inThreadNum == 0)
+										inThreadNum = getProcessorNum();
+
+									mPendingNum = 0;
+									mWaiterNum = 0;
+									mWorkerWaiterNum = 0;
+									mIdleNum = 0;
+									mNextWorker = 0;
+									mIsShutdown = false;
+
+									for (unsigned int i = 0; i < inThreadNum; i++)
+										mWorkers.push_back(new WorkerThread(this, i));
+									for (unsigned int i = 0; i < inThreadNum; i++)
+										mWorkers[i]->start();
+								}
+		virtual					~ThreadPool()
+								{
+									try
+									{
+										shutdown(false);
+									}
+
+									catch (...)
+									{
+									}
+
+									for (size_t i = 0; i < mWorkers.size(); i++)
+										delete mWorkers[i];
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					submit(Task *inTask)
+		{
+			if (inTask == NULL)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"inTask == NULL", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+			if (mIsShutdown != false)
+			{
+				throw ThreadException( ThreadException::ILLEGAL_THREAD_STATE,
+						"ThreadPool is shut down", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			mPendingNum++;
+
+			//	Tasks spawned from a worker stay on that worker's deque so they
+			//	run hot in its cache; idle workers steal them if it falls behind.
+			WorkerThread	*worker = getCurrentWorker();
+			if (worker == NULL || worker->mPool != this)
+				worker = mWorkers[mNextWorker++ % mWorkers.size()];
+
+			worker->push(inTask);
+			if (worker->mIsIdle != false)
+				worker->mWakeEvent.signal();
+			else if (mIdleNum != 0)
+				wakeIdleWorker();
+
+			//	A worker blocked in wait() does not run its own deque, so
+			//	let it pick the new task up
+			if (mWorkerWaiterNum != 0)
+				Futex::wakeAll(&mPendingNum);
+		}
+		//	Waits until no task is pending. If a task threw since the last
+		//	wait(), the first such exception is rethrown here (later ones
+		//	are dropped). Any number of threads may wait at once.
+		void					wait()
+		{
+			waitUntil(Deadline::infinite());
+		}
+		bool					timedWait(timeout_t inMilliseconds)
+		{
+			if (inMilliseconds == Thread::WAIT_INFINITE)
+				return waitUntil(Deadline::infinite());
+			return waitUntil(Deadline::fromMilliseconds(inMilliseconds));
+		}
+		//	Returns false if tasks are still pending at inDeadline
+		bool					waitUntil(const Deadline &inDeadline)
+		{
+			bool	isWorker = isWorkerThread();
+
+			//	Pairs with runTask(): either it sees us counted, or the futex
+			//	wait sees the changed count and returns at once
+			mWaiterNum++;
+			if (isWorker != false)
+				mWorkerWaiterNum++;
+
+			bool	result = true;
+			for (;;)
+			{
+				uint32_t	pendingNum = mPendingNum;
+				if (pendingNum == 0)
+					break;
+				if (isWorker != false && tryRunPendingTask() != false)
+					continue;
+				if (inDeadline.isExpired() != false)
+				{
+					result = false;
+					break;
+				}
+				Futex::waitUntil(&mPendingNum, pendingNum, inDeadline);
+			}
+
+			if (isWorker != false)
+				mWorkerWaiterNum--;
+			mWaiterNum--;
+
+			if (result != false)
+				rethrowTaskException();
+			return result;
+		}
+		bool					tryRunPendingTask()
+		{
+			WorkerThread	*worker = getCurrentWorker();
+			unsigned int	index = 0;
+			if (worker != NULL && worker->mPool == this)
+				index = worker->mIndex;
+
+			Task	*task = acquireTask(index, false);
+			if (task == NULL)
+				return false;
+
+			runTask(task);
+			return true;
+		}
+		//	A task exception reported by wait() is rethrown after the
+		//	workers are stopped
+		void					shutdown(bool inIsWaitPending = true)
+		{
+			std::exception_ptr	exception;
+			if (inIsWaitPending != false)
+			{
+				try
+				{
+					wait();
+				}
+
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+			}
+
+			if (mIsShutdown.exchange(true) == false)
+			{
+				for (size_t i = 0; i < mWorkers.size(); i++)
+					mWorkers[i]->signalStop();
+				for (size_t i = 0; i < mWorkers.size(); i++)
+					mWorkers[i]->join();
+			}
+
+			if (exception != NULL)
+				std::rethrow_exception(exception);
+		}
+		unsigned int			getThreadNum() const
+		{
+			return (unsigned int )mWorkers.size();
+		}
+		unsigned int			getPendingNum() const
+		{
+			return mPendingNum;
+		}
+		bool					isWorkerThread() const
+		{
+			WorkerThread	*worker = getCurrentWorker();
+			if (worker == NULL || worker->mPool != this)
+				return false;
+			return true;
+		}
+
+		// Static Functions ----------------------------------------------------
+		static unsigned int		getProcessorNum()
+		{
+		#ifdef _WIN32	//	Win32 specific -------------------------------------
+			SYSTEM_INFO	info;
+
+			::GetSystemInfo(&info);
+			return (unsigned int )info.dwNumberOfProcessors;
+		#elif _PTHREAD	//	pthread specific -----------------------------------
+			long	num = sysconf(_SC_NPROCESSORS_ONLN);
+			if (num <= 0)
+				return 1;
+			return (unsigned int )num;
+		#endif	// specific parts end ------------------------------------------
+		}
+
+	private:
+		// ---------------------------------------------------------------------
+		// WorkerThread class
+		// ---------------------------------------------------------------------
+		class	WorkerThread : public Thread
+		{
+		public:
+			// Constructors and Destructor -------------------------------------
+								WorkerThread(ThreadPool *inPool, unsigned int inIndex)
+									: mPool(inPool), mIndex(inIndex)
+								{
+									mIsIdle = false;
+									mIsStopRequested = false;
+								}
+			virtual				~WorkerThread()
+								{
+								}
+
+			// Member Functions ------------------------------------------------
+			void				push(Task *inTask)
+			{
+				mQueueMutex.lock();
+				mQueue.push_back(inTask);
+				mQueueMutex.unlock();
+			}
+			Task				*pop()
+			{
+				Task	*task = NULL;
+
+				mQueueMutex.lock();
+				if (mQueue.empty() == false)
+				{
+					task = mQueue.back();
+					mQueue.pop_back();
+				}
+				mQueueMutex.unlock();
+
+				return task;
+			}
+			Task				*steal(bool inIsBlocking)
+			{
+				Task	*task = NULL;
+
+				if (inIsBlocking != false)
+					mQueueMutex.lock();
+				else if (mQueueMutex.tryLock() == false)
+					return NULL;
+
+				if (mQueue.empty() == false)
+				{
+					task = mQueue.front();
+					mQueue.pop_front();
+				}
+				mQueueMutex.unlock();
+
+				return task;
+			}
+
+			// Member Variables ------------------------------------------------
+			ThreadPool				*const mPool;
+			const unsigned int		mIndex;
+			std::atomic<bool>		mIsIdle;
+			std::atomic<bool>		mIsStopRequested;
+			Event					mWakeEvent;
+
+		protected:
+			// Member Functions ------------------------------------------------
+			virtual void		runner()
+			{
+				getCurrentWorker() = this;
+
+				while (mIsStopRequested == false)
+				{
+					Task	*task = mPool->acquireTask(mIndex, false);
+					if (task != NULL)
+					{
+						mPool->runTask(task);
+						continue;
+					}
+
+					//	Publish the idle state before the final (blocking) scan,
+					//	so a concurrent submit() either sees us idle and signals
+					//	mWakeEvent, or we see its task here. No timeout is
+					//	needed: submit() and stopper() always signal.
+					mIsIdle = true;
+					mPool->mIdleNum++;
+					task = mPool->acquireTask(mIndex, true);
+					if (task == NULL && mIsStopRequested == false)
+						mWakeEvent.wait();
+					mPool->mIdleNum--;
+					mIsIdle = false;
+
+					if (task != NULL)
+						mPool->runTask(task);
+				}
+
+				getCurrentWorker() = NULL;
+			}
+			virtual void		stopper()
+			{
+				mIsStopRequested = true;
+				mWakeEvent.signal();
+			}
+
+		private:
+			// Member Variables ------------------------------------------------
+			Mutex					mQueueMutex;
+			std::deque<Task *>		mQueue;
+		};
+
+		// Member Functions ----------------------------------------------------
+		Task					*acquireTask(unsigned int inIndex, bool inIsBlocking)
+		{
+			Task	*task = mWorkers[inIndex]->pop();
+			if (task != NULL)
+				return task;
+
+			size_t	num = mWorkers.size();
+			for (size_t i = 1; i < num; i++)
+			{
+				task = mWorkers[(inIndex + i) % num]->steal(inIsBlocking);
+				if (task != NULL)
+					return task;
+			}
+
+			return NULL;
+		}
+		void					runTask(Task *inTask)
+		{
+			try
+			{
+				inTask->run();
+			}
+
+			catch (...)
+			{
+				mExceptionMutex.lock();
+				if (mTaskException == NULL)
+					mTaskException = std::current_exception();
+				mExceptionMutex.unlock();
+			}
+
+			if (--mPendingNum == 0 && mWaiterNum != 0)
+				Futex::wakeAll(&mPendingNum);
+		}
+		void					rethrowTaskException()
+		{
+			mExceptionMutex.lock();
+			std::exception_ptr	exception = mTaskException;
+			mTaskException = NULL;
+			mExceptionMutex.unlock();
+
+			if (exception != NULL)
+				std::rethrow_exception(exception);
+		}
+		void					wakeIdleWorker()
+		{
+			for (size_t i = 0; i < mWorkers.size(); i++)
+			{
+				if (mWorkers[i]->mIsIdle != false)
+				{
+					mWorkers[i]->mWakeEvent.signal();
+					return;
+				}
+			}
+		}
+
+		// Static Functions ----------------------------------------------------
+		static WorkerThread		*&getCurrentWorker()
+		{
+			static thread_local WorkerThread	*sCurrentWorker = NULL;
+			return sCurrentWorker;
+		}
+
+		// Member Variables ----------------------------------------------------
+		std::vector<WorkerThread *>	mWorkers;
+		std::atomic<uint32_t>		mPendingNum;		//	Also the futex word of wait()
+		std::atomic<uint32_t>		mWaiterNum;
+		std::atomic<uint32_t>		mWorkerWaiterNum;
+		std::atomic<unsigned int>	mIdleNum;
+		std::atomic<unsigned int>	mNextWorker;
+		std::atomic<bool>			mIsShutdown;
+		Mutex						mExceptionMutex;
+		std::exception_ptr			mTaskException;
+	};
+}
+
+#endif // TBC_THREAD_POOL_HPP
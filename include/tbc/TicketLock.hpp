@@ -0,0 +1,99 @@
+// =============================================================================
+//  TicketLock.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/TicketLock.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc ticket lock
+
+	This file defines a FIFO-fair spin lock: every locker draws a ticket
+	and waits until it is served. It has the lock()/tryLock()/unlock()
+	interface of tbc::Mutex.
+*/
+
+#ifndef TBC_TICKET_LOCK_HPP
+#define TBC_TICKET_LOCK_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "tbc/Futex.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	// -------------------------------------------------------------------------
+	// TicketLock class
+	// -------------------------------------------------------------------------
+	//	The two counters live on separate cache lines, so drawing a ticket
+	//	does not disturb the waiters reading mServing. A waiter backs off in
+	//	proportion to its distance from the head of the queue. Since the
+	//	lock is strictly FIFO, a preempted waiter stalls everybody behind
+	//	it; keep the number of threads at or below the number of cores.
+	class	TicketLock
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								TicketLock()
+								{
+									mNext.store(0, std::memory_order_relaxed);
+									mServing.store(0, std::memory_order_relaxed);
+								}
+
+		// Member Functions ----------------------------------------------------
+		void					lock()
+		{
+			uint32_t	ticket = mNext.fetch_add(1, std::memory_order_relaxed);
+			uint32_t	serving = mServing.load(std::memory_order_acquire);
+
+			for (unsigned int spin = 0; serving != ticket; spin++)
+			{
+				uint32_t	distance = ticket - serving;
+				for (uint32_t i = 0; i < distance * BACKOFF_PER_WAITER; i++)
+					Futex::cpuRelax();
+				if (spin >= YIELD_SPIN_NUM)
+					Futex::yield();
+
+				serving = mServing.load(std::memory_order_acquire);
+			}
+		}
+		bool					tryLock()
+		{
+			uint32_t	serving = mServing.load(std::memory_order_acquire);
+			uint32_t	ticket = serving;
+			return mNext.compare_exchange_strong(ticket, serving + 1,
+						std::memory_order_acquire, std::memory_order_relaxed);
+		}
+		void					unlock()
+		{
+			//	Only the holder writes mServing
+			mServing.store(mServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static size_t		CACHE_LINE_SIZE						= 64;
+		const static uint32_t	BACKOFF_PER_WAITER					= 16;
+		const static unsigned int	YIELD_SPIN_NUM					= 1000;
+
+		// Member Variables ----------------------------------------------------
+		std::atomic<uint32_t>	mNext;
+		char					mPad[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+		std::atomic<uint32_t>	mServing;
+	};
+}
+
+#endif // TBC_TICKET_LOCK_HPP
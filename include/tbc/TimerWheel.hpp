@@ -0,0 +1,419 @@
+// =============================================================================
+//  TimerWheel.hpp
+//
+//  Written in 2014 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+	\file		tbc/TimerWheel.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0.1
+	\date		2014/01/10
+	\brief		Header file for the tbc hierarchical timer wheel
+
+	This file defines a timer service that runs any number of one-shot and
+	periodic timers from a single driver thread. Timers are kept in a
+	hierarchical wheel (LEVEL_NUM levels of SLOT_NUM slots), so add() and
+	cancel() are O(1) and each tick only touches the timers that are due.
+*/
+
+#ifndef TBC_TIMER_WHEEL_HPP
+#define TBC_TIMER_WHEEL_HPP
+
+// Includes --------------------------------------------------------------------
+#include <stdint.h>
+#include <atomic>
+#include "tbc/Thread.hpp"
+#include "tbc/Mutex.hpp"
+#include "tbc/Event.hpp"
+#include "tbc/Clock.hpp"
+#include "tbc/Deadline.hpp"
+
+
+// Namespace -------------------------------------------------------------------
+namespace tbc
+{
+	class	TimerWheel;
+
+	// -------------------------------------------------------------------------
+	// Timer class
+	// -------------------------------------------------------------------------
+	//	Timers are intrusive: the wheel links the Timer object itself, so
+	//	adding a timer never allocates. The object must stay alive until it
+	//	has fired (one-shot) or has been cancelled.
+	class	Timer
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+								Timer()
+								{
+									mLink.mPrev = NULL;
+									mLink.mNext = NULL;
+									mLink.mTimer = this;
+									mWheel = NULL;
+									mExpireTick = 0;
+									mPeriodTicks = 0;
+								}
+		virtual					~Timer() {}
+
+		// Member Functions ----------------------------------------------------
+		bool					isPending() const
+		{
+			return (mLink.mNext != NULL);
+		}
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		//	Called on the driver thread, without any wheel lock held. The
+		//	callback may add or cancel timers, including itself.
+		virtual void			expired() = 0;
+
+	private:
+		friend class TimerWheel;
+
+		// ---------------------------------------------------------------------
+		// Link struct
+		// ---------------------------------------------------------------------
+		struct	Link
+		{
+			Link				*mPrev;
+			Link				*mNext;
+			Timer				*mTimer;
+		};
+
+		// Member Variables ----------------------------------------------------
+		Link					mLink;
+		TimerWheel				*mWheel;
+		uint64_t				mExpireTick;
+		uint64_t				mPeriodTicks;
+	};
+
+	// -------------------------------------------------------------------------
+	// TimerWheel class
+	// -------------------------------------------------------------------------
+	//	The driver is a tbc::Thread owned by the wheel. Callbacks run on it one
+	//	after another, so they should be short (hand long work to a
+	//	ThreadPool). The driver sleeps until the next tick, or indefinitely
+	//	while no timer is pending.
+	class	TimerWheel : protected Thread
+	{
+	public:
+		// Constructors and Destructor -----------------------------------------
+		//	inTickNanoseconds is the wheel granularity. Timeouts are rounded
+		//	up to whole ticks, so a timer never fires early.
+								TimerWheel(uint64_t inTickNanoseconds = Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT)
+								{
+									if (inTickNanoseconds == 0)
+										inTickNanoseconds = 1;
+
+									mTickNanoseconds = inTickNanoseconds;
+									mStartTime = Clock::getNanoseconds();
+									mCurrentTick = 0;
+									mTimerNum = 0;
+									mIsStopRequested = false;
+
+									for (int level = 0; level < LEVEL_NUM; level++)
+										for (int slot = 0; slot < SLOT_NUM; slot++)
+											initList(&mSlots[level][slot]);
+								}
+		virtual					~TimerWheel()
+								{
+									try
+									{
+										stop();
+									}
+
+									catch (...)
+									{
+									}
+								}
+
+		// Member Functions ----------------------------------------------------
+		//	Starts the driver thread
+		void					start()
+		{
+			mIsStopRequested = false;
+			Thread::start();
+		}
+		//	Stops the driver thread. Pending timers stay registered and fire
+		//	(late) if the wheel is started again.
+		void					stop()
+		{
+			if (Thread::isAlive() == false)
+				return;
+			Thread::signalStop();
+			Thread::join();
+		}
+		//	Arms inTimer to fire once after inDelayNanoseconds, then every
+		//	inPeriodNanoseconds if the period is not 0. An already pending
+		//	timer is re-armed.
+		void					add(Timer *inTimer, uint64_t inDelayNanoseconds, uint64_t inPeriodNanoseconds = 0)
+		{
+			if (inTimer == NULL)
+			{
+				throw ThreadException( Exception::PARAM_ERROR,
+						"inTimer == NULL", TBC_EXCEPTION_LOCATION_MACRO);
+			}
+
+			mMutex.lock();
+			{
+				if (inTimer->isPending() != false && inTimer->mWheel != this)
+				{
+					mMutex.unlock();
+					throw ThreadException( Exception::PARAM_ERROR,
+							"inTimer belongs to another TimerWheel", TBC_EXCEPTION_LOCATION_MACRO);
+				}
+				if (inTimer->isPending() != false)
+					unlinkTimer(inTimer);
+
+				uint64_t	now = Clock::getNanoseconds() - mStartTime;
+				if (mTimerNum == 0 && now / mTickNanoseconds > mCurrentTick)
+					mCurrentTick = now / mTickNanoseconds;
+
+				//	Round the absolute expiry up, so the timer fires no earlier
+				//	than inDelayNanoseconds from now
+				inTimer->mWheel = this;
+				inTimer->mExpireTick = toTicks(now + inDelayNanoseconds);
+				inTimer->mPeriodTicks = 0;
+				if (inPeriodNanoseconds != 0)
+					inTimer->mPeriodTicks = toTicks(inPeriodNanoseconds);
+				insertTimer(inTimer, mCurrentTick + 1);
+			}
+			bool	isWakeNeeded = (mTimerNum == 1);
+			mMutex.unlock();
+
+			//	The driver sleeps without a timeout while the wheel is empty
+			if (isWakeNeeded != false)
+				mWakeEvent.signal();
+		}
+		void					addMilliseconds(Timer *inTimer, timeout_t inDelay, timeout_t inPeriod = 0)
+		{
+			const uint64_t	unit = Clock::NANO_SECOND_UNIT / Clock::MILLI_SECOND_UNIT;
+			add(inTimer, (uint64_t )inDelay * unit, (uint64_t )inPeriod * unit);
+		}
+		//	Returns false if the timer was not pending. A periodic timer that
+		//	is cancelled while its callback runs is not re-armed, but the
+		//	running callback is not waited for.
+		bool					cancel(Timer *inTimer)
+		{
+			bool	result = false;
+
+			mMutex.lock();
+			{
+				if (inTimer->mWheel == this && inTimer->isPending() != false)
+				{
+					unlinkTimer(inTimer);
+					result = true;
+				}
+			}
+			mMutex.unlock();
+
+			return result;
+		}
+		unsigned int			getTimerNum() const
+		{
+			return mTimerNum;
+		}
+		uint64_t				getTickNanoseconds() const
+		{
+			return mTickNanoseconds;
+		}
+
+		// Constatns -----------------------------------------------------------
+		const static int		SLOT_BITS							= 8;
+		const static int		SLOT_NUM							= 1 << SLOT_BITS;
+		const static int		LEVEL_NUM							= 4;
+
+	protected:
+		// Member Functions ----------------------------------------------------
+		virtual void			runner()
+		{
+			while (mIsStopRequested == false)
+			{
+				uint64_t	now = Clock::getNanoseconds() - mStartTime;
+				uint64_t	targetTick = now / mTickNanoseconds;
+
+				while (getCurrentTick() < targetTick && mIsStopRequested == false)
+					advance(targetTick);
+
+				if (mTimerNum == 0)
+				{
+					mWakeEvent.wait();
+					continue;
+				}
+
+				//	Wakes at the tick boundary itself rather than the next
+				//	whole millisecond, so sub-millisecond ticks keep up
+				uint64_t	next = (getCurrentTick() + 1) * mTickNanoseconds;
+				mWakeEvent.waitUntil(Deadline(mStartTime + next));
+			}
+		}
+		virtual void			stopper()
+		{
+			mIsStopRequested = true;
+			mWakeEvent.signal();
+		}
+
+	private:
+		// Constatns -----------------------------------------------------------
+		const static uint64_t	SLOT_MASK							= SLOT_NUM - 1;
+		const static uint64_t	MAX_TICKS							= ((uint64_t )1 << (SLOT_BITS * LEVEL_NUM)) - 1;
+
+		// Member Functions ----------------------------------------------------
+		uint64_t				toTicks(uint64_t inNanoseconds) const
+		{
+			uint64_t	ticks = (inNanoseconds + mTickNanoseconds - 1) / mTickNanoseconds;
+			if (ticks == 0)
+				ticks = 1;
+			return ticks;
+		}
+		//	The driver reads the tick under mMutex; add() moves it forward
+		//	when the wheel is empty
+		uint64_t				getCurrentTick()
+		{
+			mMutex.lock();
+			uint64_t	tick = mCurrentTick;
+			mMutex.unlock();
+			return tick;
+		}
+		static void				initList(Timer::Link *inHead)
+		{
+			inHead->mPrev = inHead;
+			inHead->mNext = inHead;
+			inHead->mTimer = NULL;
+		}
+		static void				linkTimer(Timer::Link *inHead, Timer *inTimer)
+		{
+			Timer::Link	*link = &inTimer->mLink;
+
+			link->mPrev = inHead->mPrev;
+			link->mNext = inHead;
+			inHead->mPrev->mNext = link;
+			inHead->mPrev = link;
+		}
+		void					unlinkTimer(Timer *inTimer)
+		{
+			Timer::Link	*link = &inTimer->mLink;
+
+			link->mPrev->mNext = link->mNext;
+			link->mNext->mPrev = link->mPrev;
+			link->mPrev = NULL;
+			link->mNext = NULL;
+			mTimerNum--;
+		}
+		//	Places a timer in the lowest level whose range covers its expiry.
+		//	Timers beyond the wheel range are parked in the top level at the
+		//	maximum distance and placed again when that slot cascades.
+		//	inMinTick is mCurrentTick while cascading (the current level 0
+		//	slot is still to be processed) and mCurrentTick + 1 otherwise.
+		void					insertTimer(Timer *inTimer, uint64_t inMinTick)
+		{
+			uint64_t	expire = inTimer->mExpireTick;
+			if (expire < inMinTick)
+				expire = inMinTick;
+
+			uint64_t	delta = expire - mCurrentTick;
+			if (delta > MAX_TICKS)
+			{
+				delta = MAX_TICKS;
+				expire = mCurrentTick + MAX_TICKS;
+			}
+
+			int		level = 0;
+			while (level < LEVEL_NUM - 1 && delta >= ((uint64_t )1 << (SLOT_BITS * (level + 1))))
+				level++;
+
+			linkTimer(&mSlots[level][(expire >> (SLOT_BITS * level)) & SLOT_MASK], inTimer);
+			mTimerNum++;
+		}
+		void					cascade(int inLevel)
+		{
+			Timer::Link	*head = &mSlots[inLevel][(mCurrentTick >> (SLOT_BITS * inLevel)) & SLOT_MASK];
+
+			while (head->mNext != head)
+			{
+				Timer	*timer = head->mNext->mTimer;
+				unlinkTimer(timer);
+				insertTimer(timer, mCurrentTick);
+			}
+		}
+		void					advance(uint64_t inTargetTick)
+		{
+			Timer::Link	expiredList;
+
+			initList(&expiredList);
+
+			mMutex.lock();
+			{
+				//	Nothing to cascade or fire in an empty wheel
+				if (mTimerNum == 0)
+				{
+					mCurrentTick = inTargetTick;
+					mMutex.unlock();
+					return;
+				}
+
+				mCurrentTick++;
+				for (int level = 1; level < LEVEL_NUM; level++)
+				{
+					if (((mCurrentTick >> (SLOT_BITS * (level - 1))) & SLOT_MASK) != 0)
+						break;
+					cascade(level);
+				}
+
+				//	Move the due slot to a local list. cancel() can still unlink
+				//	timers from it because the list keeps the same linkage.
+				Timer::Link	*head = &mSlots[0][mCurrentTick & SLOT_MASK];
+				if (head->mNext != head)
+				{
+					expiredList.mNext = head->mNext;
+					expiredList.mPrev = head->mPrev;
+					expiredList.mNext->mPrev = &expiredList;
+					expiredList.mPrev->mNext = &expiredList;
+					initList(head);
+				}
+
+				while (expiredList.mNext != &expiredList)
+				{
+					Timer	*timer = expiredList.mNext->mTimer;
+					unlinkTimer(timer);
+					if (timer->mPeriodTicks != 0)
+					{
+						timer->mExpireTick += timer->mPeriodTicks;
+						insertTimer(timer, mCurrentTick + 1);
+					}
+
+					mMutex.unlock();
+					try
+					{
+						timer->expired();
+					}
+
+					catch (...)
+					{
+					}
+					mMutex.lock();
+				}
+			}
+			mMutex.unlock();
+		}
+
+		// Member Variables ----------------------------------------------------
+		Mutex					mMutex;
+		Event					mWakeEvent;
+		Timer::Link				mSlots[LEVEL_NUM][SLOT_NUM];
+		uint64_t				mTickNanoseconds;
+		uint64_t				mStartTime;
+		uint64_t				mCurrentTick;		//	Guarded by mMutex
+		std::atomic<unsigned int>	mTimerNum;		//	Written under mMutex
+		std::atomic<bool>		mIsStopRequested;
+	};
+}
+
+#endif // TBC_TIMER_WHEEL_HPP
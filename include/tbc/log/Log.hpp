@@ -25,6 +25,7 @@
 
 // Includes --------------------------------------------------------------------
 #include <stdio.h>
+#include "tbc/SeqLock.hpp"
 
 // Macros ----------------------------------------------------------------------
 #ifndef _DEBUG
@@ -119,16 +120,26 @@ namespace tbc
 		virtual					~LogBase() {}
 
 		// Member Functions ----------------------------------------------------
-		unsigned int			getLogOutTypeMask() { return mOutTypeMask; }
-		void					setLogOutTypeMask(unsigned int inOutTypeMask) { mOutTypeMask = inOutTypeMask; }
-		unsigned char			getLogOutLevel() { return mOutLevel; }
-		void					setLogOutLevel(unsigned char inOutLevel) { mOutLevel = inOutLevel; }
+		unsigned int			getLogOutTypeMask() { return mOutFilter.load().mTypeMask; }
+		void					setLogOutTypeMask(unsigned int inOutTypeMask)
+								{
+									mOutFilter.update([inOutTypeMask](OutFilter &ioFilter) { ioFilter.mTypeMask = inOutTypeMask; });
+								}
+		unsigned char			getLogOutLevel() { return mOutFilter.load().mLevel; }
+		void					setLogOutLevel(unsigned char inOutLevel)
+								{
+									mOutFilter.update([inOutLevel](OutFilter &ioFilter) { ioFilter.mLevel = inOutLevel; });
+								}
+		//	Called from any thread on every message; reads the filter
+		//	without locking
 		bool					isLogOutMessage(unsigned int inType, unsigned char inLevel)
 								{
-									if ((inType & mOutTypeMask) == 0)
+									OutFilter	filter = mOutFilter.load();
+
+									if ((inType & filter.mTypeMask) == 0)
 										return false;
 
-									if (inLevel > mOutLevel)
+									if (inLevel > filter.mLevel)
 										return false;
 
 									return true;
@@ -137,13 +148,15 @@ namespace tbc
 		// Constructor ---------------------------------------------------------
 								LogBase()
 								{
+									OutFilter	filter;
 								#ifdef _DEBUG
-									mOutTypeMask = INFO_MSG + WARNING_MSG + ERROR_MSG + DUMP_MSG + TRACE_MSG + DEBUG_MSG;
-									mOutLevel = DETAIL_LEVEL;
+									filter.mTypeMask = INFO_MSG + WARNING_MSG + ERROR_MSG + DUMP_MSG + TRACE_MSG + DEBUG_MSG;
+									filter.mLevel = DETAIL_LEVEL;
 								#else
-									mOutTypeMask = INFO_MSG + WARNING_MSG + ERROR_MSG;
-									mOutLevel = NORMAL_LEVEL;
+									filter.mTypeMask = INFO_MSG + WARNING_MSG + ERROR_MSG;
+									filter.mLevel = NORMAL_LEVEL;
 								#endif
+									mOutFilter.store(filter);
 								}
 								
 
@@ -202,6 +215,19 @@ namespace tbc
 				tmPtr->tm_min, tmPtr->tm_sec);
 		#endif	// specific parts end ------------------------------------------
 		}
+
+	private:
+		// ---------------------------------------------------------------------
+		// OutFilter class
+		// ---------------------------------------------------------------------
+		struct	OutFilter
+		{
+			unsigned int		mTypeMask;
+			unsigned char		mLevel;
+		};
+
+		// Member Variables ----------------------------------------------------
+		SeqLock<OutFilter>		mOutFilter;
 	}
 }
 